@@ -1,8 +1,82 @@
-/* Make sure collision detection works properly. */
+/* Make sure collision detection works properly. The collider tests move boxes
+around small made-up maps and check that nothing ever ends up inside a tile or
+gets through a wall, however fast it goes. There's also a benchmark, which
+doesn't run unless asked for:
+$ ./collider_tests "[bench]"
+*/
 
 #define CATCH_CONFIG_MAIN // Tells catch to provide a main()
 #include "catch.hpp"
-#include "Collider.hh"
+#include "src/Collider.hh"
+
+#include <chrono>
+#include <iostream>
+
+#define TILE_SIZE 16
+
+/* An entity that's just a box, so tests can say where it is and how big. */
+class Box : public Entity {
+public:
+    Box(int x, int y, int w, int h) {
+        rect.x = x;
+        rect.y = y;
+        rect.w = w;
+        rect.h = h;
+        rect.worldWidth = 0;
+        nextRect = rect;
+        nextRect.x = 0;
+        nextRect.y = 0;
+        drag = {1, 1};
+        gravity = false;
+        hasInventory = false;
+        invincibilityTime = 0;
+        invincibilityLeft = 0;
+        maxFallDistance = -1;
+        savePosition();
+    }
+};
+
+/* Set the tiles from left to right and bottom to top, not including right
+and top. */
+static void fill(Map &map, int left, int right, int bottom, int top,
+        TileType type) {
+    for (int x = left; x < right; x++) {
+        for (int y = bottom; y < top; y++) {
+            map.setTile(x, y, MapLayer::FOREGROUND, type);
+        }
+    }
+}
+
+/* Move a box for one tick at the given velocity. */
+static void step(Collider &collider, Map &map, Box &box, double vx,
+        double vy) {
+    SlotMap<Entity> entities;
+    entities.insert(&box);
+    SlotMap<DroppedItem> items;
+    box.setVelocity({vx, vy});
+    collider.update(map, entities, items);
+}
+
+/* Put the box somewhere random in the rectangle of tiles that it doesn't
+overlap anything solid. */
+static void placeRandomly(Collider &collider, Map &map, Box &box,
+        RandomStream &random, int left, int right, int bottom, int top) {
+    Rect rect = box.getRect();
+    rect.worldWidth = map.getWidth() * TILE_SIZE;
+    do {
+        rect.x = left * TILE_SIZE
+            + random.below((right - left) * TILE_SIZE - rect.w);
+        rect.y = bottom * TILE_SIZE
+            + random.below((top - bottom) * TILE_SIZE - rect.h);
+    } while (collider.overlapsSolid(map, rect));
+    box.setX(rect.x);
+    box.setY(rect.y);
+}
+
+/* A random velocity up to speed in each direction. */
+static double randomSpeed(RandomStream &random, int speed) {
+    return (double)random.below(2 * speed + 1) - speed;
+}
 
 TEST_CASE("test Rect.intersects", "[intersects]") {
     Rect one;
@@ -49,7 +123,7 @@ TEST_CASE("test Rect.intersects", "[intersects]") {
 
             REQUIRE(one.intersects(two) == two.intersects(one));
             bool noWrapping = one.intersects(two);
-            
+
             SECTION("wrapping around the large side") {
                 one.x += one.worldWidth;
                 bool wrapping = one.intersects(two);
@@ -64,3 +138,244 @@ TEST_CASE("test Rect.intersects", "[intersects]") {
         }
     }
 }
+
+TEST_CASE("movables never end up inside solid tiles", "[collider]") {
+    Map map(128, 64, TILE_SIZE, TILE_SIZE);
+    Collider collider(TILE_SIZE, TILE_SIZE);
+    RandomStream random(1);
+
+    /* Scatter stone around, a tenth of the tiles or so. */
+    for (int x = 0; x < map.getWidth(); x++) {
+        for (int y = 0; y < map.getHeight(); y++) {
+            if (random.below(10) == 0) {
+                map.setTile(x, y, MapLayer::FOREGROUND, TileType::STONE);
+            }
+        }
+    }
+
+    for (int i = 0; i < 200; i++) {
+        Box box(0, 0, 4 + random.below(40), 4 + random.below(40));
+        box.gravity = random.below(2);
+        placeRandomly(collider, map, box, random, 0, map.getWidth(), 4,
+            map.getHeight() - 4);
+        int speed = 1 << random.below(10);
+        for (int j = 0; j < 20; j++) {
+            step(collider, map, box, randomSpeed(random, speed),
+                randomSpeed(random, speed));
+            Rect rect = box.getRect();
+            INFO("box " << i << " tick " << j << " at " << rect.x << ", "
+                << rect.y << " size " << rect.w << " by " << rect.h);
+            REQUIRE(0 <= rect.x);
+            REQUIRE(rect.x < map.getWidth() * TILE_SIZE);
+            REQUIRE_FALSE(collider.overlapsSolid(map, rect));
+        }
+    }
+}
+
+TEST_CASE("nothing goes through a wall at any speed", "[collider]") {
+    Map map(128, 64, TILE_SIZE, TILE_SIZE);
+    Collider collider(TILE_SIZE, TILE_SIZE);
+    RandomStream random(2);
+
+    /* A closed room from 10 to 40 across and 10 to 30 up, split in half by a
+    wall one tile thick. Things can overlap walls by the collider's offset,
+    which is one pixel. */
+    fill(map, 9, 41, 9, 31, TileType::STONE);
+    fill(map, 10, 40, 10, 30, TileType::EMPTY);
+    fill(map, 25, 26, 10, 30, TileType::STONE);
+
+    for (int i = 0; i < 100; i++) {
+        Box box(0, 0, 4 + random.below(40), 4 + random.below(40));
+        box.gravity = random.below(2);
+        bool left = random.below(2);
+        if (left) {
+            placeRandomly(collider, map, box, random, 10, 25, 10, 30);
+        }
+        else {
+            placeRandomly(collider, map, box, random, 26, 40, 10, 30);
+        }
+        int speed = 1 << random.below(12);
+        for (int j = 0; j < 20; j++) {
+            step(collider, map, box, randomSpeed(random, speed),
+                randomSpeed(random, speed));
+            Rect rect = box.getRect();
+            INFO("box " << i << " tick " << j << " at " << rect.x << ", "
+                << rect.y << " size " << rect.w << " by " << rect.h);
+            REQUIRE(rect.x >= (left? 10 : 26) * TILE_SIZE - 1);
+            REQUIRE(rect.x + rect.w <= (left? 25 : 40) * TILE_SIZE + 1);
+            REQUIRE(rect.y >= 10 * TILE_SIZE - 1);
+            REQUIRE(rect.y + rect.h <= 30 * TILE_SIZE + 1);
+        }
+    }
+}
+
+TEST_CASE("things fall through gaps they fit through", "[collider]") {
+    Map map(128, 64, TILE_SIZE, TILE_SIZE);
+    Collider collider(TILE_SIZE, TILE_SIZE);
+
+    /* A shelf with a gap two tiles wide at 30 and 31. With the offset, the
+    opening goes from one pixel left of 30 to one pixel right of 31. */
+    fill(map, 0, 60, 20, 21, TileType::STONE);
+    fill(map, 30, 32, 20, 21, TileType::EMPTY);
+    int openLeft = 30 * TILE_SIZE - 1;
+    int openRight = 32 * TILE_SIZE + 1;
+
+    for (int w = 20; w <= 40; w += 4) {
+        for (int x = openLeft - 20; x < openRight; x++) {
+            Box box(x, 25 * TILE_SIZE, w, 20);
+            for (int j = 0; j < 4; j++) {
+                step(collider, map, box, 0, -100);
+            }
+            bool fits = openLeft <= x && x + w <= openRight;
+            INFO("width " << w << " from " << x);
+            REQUIRE((box.getRect().y < 20 * TILE_SIZE) == fits);
+            REQUIRE(box.getRect().x == x);
+        }
+    }
+}
+
+TEST_CASE("platforms only stop things falling onto them", "[collider]") {
+    Map map(128, 64, TILE_SIZE, TILE_SIZE);
+    Collider collider(TILE_SIZE, TILE_SIZE);
+    fill(map, 0, 60, 20, 21, TileType::PLATFORM);
+
+    SECTION("going up through") {
+        Box box(100, 15 * TILE_SIZE, 20, 20);
+        step(collider, map, box, 0, 200);
+        REQUIRE(box.getRect().y == 15 * TILE_SIZE + 200);
+    }
+
+    SECTION("landing on top") {
+        for (int speed = 1; speed <= 1024; speed *= 2) {
+            Box box(100, 25 * TILE_SIZE, 20, 20);
+            for (int j = 0; j < 2000 / speed + 2; j++) {
+                step(collider, map, box, 0, -speed);
+            }
+            INFO("falling at " << speed);
+            REQUIRE(box.getRect().y == 21 * TILE_SIZE - 1);
+            REQUIRE(box.isCollidingDown);
+        }
+    }
+}
+
+TEST_CASE("movables wrap around the edge of the world", "[collider]") {
+    Map map(128, 64, TILE_SIZE, TILE_SIZE);
+    Collider collider(TILE_SIZE, TILE_SIZE);
+    int worldWidth = map.getWidth() * TILE_SIZE;
+
+    SECTION("going right") {
+        Box box(worldWidth - 10, 30 * TILE_SIZE, 20, 20);
+        step(collider, map, box, 30, 0);
+        REQUIRE(box.getRect().x == 20);
+    }
+
+    SECTION("going left") {
+        Box box(5, 30 * TILE_SIZE, 20, 20);
+        step(collider, map, box, -30, 0);
+        REQUIRE(box.getRect().x == worldWidth - 25);
+    }
+
+    SECTION("walls on the other side still stop things") {
+        fill(map, 0, 1, 0, map.getHeight(), TileType::STONE);
+        for (int speed = 32; speed <= 4096; speed *= 2) {
+            Box right(worldWidth - 40, 30 * TILE_SIZE, 20, 20);
+            step(collider, map, right, speed, 0);
+            REQUIRE(right.getRect().x == worldWidth + 1 - 20);
+            REQUIRE(right.isCollidingX);
+
+            Box left(2 * TILE_SIZE, 30 * TILE_SIZE, 20, 20);
+            step(collider, map, left, -speed, 0);
+            REQUIRE(left.getRect().x == TILE_SIZE - 1);
+            REQUIRE(left.isCollidingX);
+        }
+    }
+}
+
+TEST_CASE("physics fields change how things move", "[collider]") {
+    /* Three chunks across: normal, low gravity, and an updraft. */
+    Map map(3 * CHUNK_SIZE, 2 * CHUNK_SIZE, TILE_SIZE, TILE_SIZE);
+    Collider collider(TILE_SIZE, TILE_SIZE);
+    PhysicsField low;
+    low.gravityScale = 0.25;
+    map.setField(1, 1, low);
+    PhysicsField updraft;
+    updraft.lift = -2 * map.getGravity();
+    map.setField(2, 1, updraft);
+
+    SlotMap<Entity> entities;
+    SlotMap<DroppedItem> items;
+    std::vector<Box> boxes;
+    for (int i = 0; i < 3; i++) {
+        boxes.emplace_back((i * CHUNK_SIZE + 30) * TILE_SIZE,
+            90 * TILE_SIZE, 16, 16);
+        boxes.back().gravity = true;
+    }
+    for (int i = 0; i < 3; i++) {
+        entities.insert(&boxes[i]);
+    }
+    for (int tick = 0; tick < 10; tick++) {
+        collider.update(map, entities, items);
+    }
+    int start = 90 * TILE_SIZE;
+    REQUIRE(boxes[0].getRect().y < boxes[1].getRect().y);
+    REQUIRE(boxes[1].getRect().y < start);
+    REQUIRE(boxes[2].getRect().y > start);
+
+    SECTION("water slows things down") {
+        fill(map, 0, 20, 10, 20, TileType::WATER);
+        Box wet(2 * TILE_SIZE, 12 * TILE_SIZE, 16, 16);
+        Box dry(2 * TILE_SIZE, 40 * TILE_SIZE, 16, 16);
+        step(collider, map, wet, 20, 0);
+        step(collider, map, dry, 20, 0);
+        REQUIRE(wet.getVelocity().x < dry.getVelocity().x);
+        REQUIRE(wet.getRect().x < dry.getRect().x);
+    }
+}
+
+TEST_CASE("collider benchmark", "[.bench]") {
+    Map map(256, 128, TILE_SIZE, TILE_SIZE);
+    Collider collider(TILE_SIZE, TILE_SIZE);
+    RandomStream random(3);
+
+    /* An open cave: a floor, a ceiling, and some stone in between. */
+    fill(map, 0, map.getWidth(), 0, 8, TileType::STONE);
+    fill(map, 0, map.getWidth(), 120, 128, TileType::STONE);
+    for (int x = 0; x < map.getWidth(); x++) {
+        for (int y = 8; y < 120; y++) {
+            if (random.below(20) == 0) {
+                map.setTile(x, y, MapLayer::FOREGROUND, TileType::STONE);
+            }
+        }
+    }
+
+    const int count = 200;
+    const int ticks = 200;
+    for (int speed = 1; speed <= 256; speed *= 4) {
+        std::vector<Box> boxes;
+        for (int i = 0; i < count; i++) {
+            boxes.emplace_back(0, 0, 38, 32);
+            boxes.back().gravity = true;
+            placeRandomly(collider, map, boxes.back(), random, 0,
+                map.getWidth(), 8, 120);
+        }
+        SlotMap<Entity> entities;
+        for (int i = 0; i < count; i++) {
+            entities.insert(&boxes[i]);
+        }
+        SlotMap<DroppedItem> items;
+
+        std::chrono::duration<double> time(0);
+        for (int t = 0; t < ticks; t++) {
+            for (int i = 0; i < count; i++) {
+                boxes[i].setVelocity({randomSpeed(random, speed),
+                    randomSpeed(random, speed)});
+            }
+            auto start = std::chrono::steady_clock::now();
+            collider.update(map, entities, items);
+            time += std::chrono::steady_clock::now() - start;
+        }
+        std::cout << "speed " << speed << ": "
+            << time.count() * 1e9 / (count * ticks)
+            << " ns per movable update\n";
+    }
+}
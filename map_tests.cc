@@ -0,0 +1,77 @@
+/* Make sure tiles on the map update in the right order. This needs to be run
+from the folder with the game's content in it, same as the game. */
+
+#define CATCH_CONFIG_MAIN // Tells catch to provide a main()
+#include "catch.hpp"
+#include "src/world/Map.hh"
+#include "src/entity/DroppedItem.hh"
+
+#define TILE_SIZE 16
+
+/* Where the ground is, so the sand has something to land on. */
+#define FLOOR 8
+
+/* The height of the lowest tile of that type in column x that isn't below
+bottom, or -1 if there isn't one. */
+static int findTile(const Map &map, int x, int bottom, TileType type) {
+    for (int y = bottom; y < map.getHeight(); y++) {
+        if (map.getTileType(x, y, MapLayer::FOREGROUND) == type) {
+            return y;
+        }
+    }
+    return -1;
+}
+
+TEST_CASE("stacks fall together across chunk rows", "[map]") {
+    /* An odd number of chunks wide, so the last column has a group of its
+    own. */
+    Map map(3 * CHUNK_SIZE, 3 * CHUNK_SIZE, TILE_SIZE, TILE_SIZE);
+    SlotMap<DroppedItem> items;
+    for (int x = 0; x < map.getWidth(); x++) {
+        for (int y = 0; y < FLOOR; y++) {
+            map.setTile(x, y, MapLayer::FOREGROUND, TileType::STONE);
+        }
+    }
+    /* Tiles only get scheduled once their chunk is simulated. */
+    map.simulateNear(map.getWidth() / 2, map.getHeight() / 2);
+    map.update(items);
+
+    /* A stack of two sand tiles in each column of chunks, with the bottom
+    one at the top of one row of chunks and the top one at the bottom of the
+    row above. Putting the top one in first means both are due to fall on
+    the same tick, and the top one can only fall if the bottom one already
+    got out of the way. */
+    int columns[3] = {10, CHUNK_SIZE + 10, 3 * CHUNK_SIZE - 10};
+    int start = 2 * CHUNK_SIZE - 1;
+    for (int k = 0; k < 3; k++) {
+        map.setTile(columns[k], start + 1, MapLayer::FOREGROUND,
+            TileType::SAND);
+        map.setTile(columns[k], start, MapLayer::FOREGROUND, TileType::SAND);
+    }
+
+    /* Falling a tile every few ticks, they land well before this. */
+    bool moved = false;
+    for (int t = 0; t < 10 * CHUNK_SIZE; t++) {
+        map.simulateNear(map.getWidth() / 2, map.getHeight() / 2);
+        map.update(items);
+        for (int k = 0; k < 3; k++) {
+            int bottom = findTile(map, columns[k], FLOOR, TileType::SAND);
+            int top = findTile(map, columns[k], bottom + 1, TileType::SAND);
+            INFO("column " << columns[k] << ", tick " << t);
+            REQUIRE(bottom != -1);
+            REQUIRE(top != -1);
+            /* The first time they fall, they fall together. */
+            if (!moved && bottom != start) {
+                CHECK(top == bottom + 1);
+            }
+        }
+        moved = findTile(map, columns[0], FLOOR, TileType::SAND) != start;
+    }
+
+    for (int k = 0; k < 3; k++) {
+        INFO("column " << columns[k]);
+        CHECK(findTile(map, columns[k], FLOOR, TileType::SAND) == FLOOR);
+        CHECK(findTile(map, columns[k], FLOOR + 1, TileType::SAND)
+            == FLOOR + 1);
+    }
+}
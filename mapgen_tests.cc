@@ -0,0 +1,100 @@
+/* Make sure a streamed world comes out the same whichever order its chunks
+are made in, so it doesn't matter which chunks get made first or whether the
+chunks around them exist yet, and that settling water never makes or loses
+any, whether the world is made all at once or a chunk at a time. This needs to
+be run from the folder with the game's content in it, same as the game. */
+
+#define CATCH_CONFIG_MAIN // Tells catch to provide a main()
+#include "catch.hpp"
+#include "src/world/Mapgen.hh"
+
+#include <cstdio> // For remove
+#include <mutex>
+#include <string>
+
+/* Big enough for the ocean and shores to fit, small enough to make quickly. */
+#define TEST_WIDTH 512
+#define TEST_HEIGHT 256
+#define TEST_SEED 12345
+
+#define CHUNKS_WIDE (TEST_WIDTH / CHUNK_SIZE)
+#define CHUNKS_HIGH (TEST_HEIGHT / CHUNK_SIZE)
+
+/* Water only moves while settling, so what's left should be what was there
+less what was taken away. */
+static void checkTally(const WaterTally &tally) {
+    INFO("found " << tally.found << ", removed " << tally.removed
+        << ", settled " << tally.settled);
+    CHECK(tally.found > 0);
+    CHECK(tally.settled > 0);
+    CHECK(tally.removed >= 0);
+    CHECK(tally.found - tally.removed == tally.settled);
+}
+
+TEST_CASE("streamed chunks don't depend on the order they're made in",
+        "[mapgen]") {
+    /* One world is made from the bottom up, a row of chunks at a time, the
+    other from the top down, a column of chunks at a time. */
+    Mapgen up;
+    up.setupChunks(TEST_SEED, TEST_WIDTH, TEST_HEIGHT);
+    Chunk *chunks[CHUNKS_WIDE * CHUNKS_HIGH];
+    for (int chunkY = 0; chunkY < CHUNKS_HIGH; chunkY++) {
+        for (int chunkX = 0; chunkX < CHUNKS_WIDE; chunkX++) {
+            Chunk *chunk = new Chunk();
+            up.generateChunk(chunk, chunkX, chunkY);
+            chunks[chunkY * CHUNKS_WIDE + chunkX] = chunk;
+        }
+    }
+
+    Mapgen down;
+    down.setupChunks(TEST_SEED, TEST_WIDTH, TEST_HEIGHT);
+    int water = 0;
+    for (int chunkX = CHUNKS_WIDE - 1; chunkX >= 0; chunkX--) {
+        for (int chunkY = CHUNKS_HIGH - 1; chunkY >= 0; chunkY--) {
+            Chunk chunk;
+            down.generateChunk(&chunk, chunkX, chunkY);
+            Chunk *other = chunks[chunkY * CHUNKS_WIDE + chunkX];
+            int different = 0;
+            for (int j = 0; j < CHUNK_SIZE; j++) {
+                for (int i = 0; i < CHUNK_SIZE; i++) {
+                    const SpaceInfo *a = chunk.getSpace(i, j);
+                    const SpaceInfo *b = other -> getSpace(i, j);
+                    different += a -> foreground != b -> foreground
+                        || a -> background != b -> background
+                        || a -> foregroundVariant != b -> foregroundVariant
+                        || a -> backgroundVariant != b -> backgroundVariant;
+                    water += a -> foreground == TileType::WATER;
+                }
+            }
+            INFO("chunk " << chunkX << ", " << chunkY);
+            CHECK(different == 0);
+        }
+    }
+
+    for (int i = 0; i < CHUNKS_WIDE * CHUNKS_HIGH; i++) {
+        delete chunks[i];
+    }
+
+    /* Otherwise this wouldn't say anything about settling water. */
+    CHECK(water > 0);
+    checkTally(up.getWaterTally());
+    checkTally(down.getWaterTally());
+}
+
+TEST_CASE("settling a whole world keeps its water", "[mapgen]") {
+    /* Nothing is waiting on the status, but Mapgen still reports it. */
+    CreateState state = CreateState::NOT_STARTED;
+    int progress = 0;
+    std::mutex m;
+
+    /* The usual size, since finding the shores needs land on both sides of
+    the ocean, which a small world might not have. */
+    Mapgen whole;
+    whole.setSeed(TEST_SEED);
+    std::string filename = "mapgen_tests.world";
+    whole.generate(filename, WorldType::EARTH, &state, &progress, &m);
+    /* Only the map in memory gets looked at. */
+    std::remove(filename.c_str());
+
+    checkTally(whole.getWaterTally());
+}
@@ -112,7 +112,9 @@ def build_object(filename, src_dir, obj_dir, dep_dir):
         out = subprocess.run(shlex.split(command))
         return out.returncode
 
-def build(exec_name, src_dir='src', obj_dir='obj', dep_dir='.d', bin_dir='.'):
+def build_objects(src_dir, obj_dir, dep_dir):
+    '''Builds object files for every c file in src_dir, if needed.
+    Returns a list of the object files, or None if compilation failed.'''
     # Get a list of c (.c, .cc, .cpp) files
     def is_cpp(name):
         return name.endswith('.cc') or name.endswith('.cpp') \
@@ -120,20 +122,51 @@ def build(exec_name, src_dir='src', obj_dir='obj', dep_dir='.d', bin_dir='.'):
     l = filter(is_cpp, list_files_recursive(src_dir))
     # Build object files if needed
     success = True
+    objects = []
     for s in l:
-        ret = build_object(s[len('src/'):], src_dir, obj_dir, dep_dir)
+        filename = s[len(src_dir + '/'):]
+        ret = build_object(filename, src_dir, obj_dir, dep_dir)
         success = success and not ret
+        objects += [os.path.join(obj_dir,
+            filename[:filename.rfind('.')] + '.o')]
     if not success:
         print('Object compilation failed.')
-        return
-    # Build the executable
-    objects = ' '.join(list_files_recursive(obj_dir))
+        return None
+    return objects
+
+def link(objects, exec_name, bin_dir):
     bin_name = os.path.join(bin_dir, exec_name)
     create_directory(os.path.dirname(bin_name))
-    command = f'{CXX} {objects} {LINKER_FLAGS} -o {bin_name}'
+    command = f'{CXX} {" ".join(objects)} {LINKER_FLAGS} -o {bin_name}'
     print(command)
     subprocess.run(shlex.split(command))
 
+def build(exec_name, src_dir='src', obj_dir='obj', dep_dir='.d', bin_dir='.'):
+    objects = build_objects(src_dir, obj_dir, dep_dir)
+    if objects is None:
+        return
+    link(objects, exec_name, bin_dir)
+
+def build_tool(exec_name, src_dir='src', obj_dir='obj', dep_dir='.d',
+        bin_dir='.', tool_dir='tools', main='main.cc'):
+    '''Builds an executable from one file in tool_dir, linked with every
+    object from src_dir except the one with the game's main function. The
+    tool's own object and dependency files go in a subfolder named after
+    tool_dir so they never get linked into the game.'''
+    objects = build_objects(src_dir, obj_dir, dep_dir)
+    if objects is None:
+        return
+    main_name = os.path.join(obj_dir, main[:main.rfind('.')] + '.o')
+    objects.remove(main_name)
+    tool_obj_dir = os.path.join(obj_dir, tool_dir)
+    tool_dep_dir = os.path.join(dep_dir, tool_dir)
+    ret = build_object(exec_name + '.cc', tool_dir, tool_obj_dir, tool_dep_dir)
+    if ret:
+        print('Object compilation failed.')
+        return
+    objects += [os.path.join(tool_obj_dir, exec_name + '.o')]
+    link(objects, exec_name, bin_dir)
+
 def lint(clang, src_dir='src'):
     l = list_files_recursive(src_dir)
     for f in l:
@@ -147,10 +180,20 @@ def lint(clang, src_dir='src'):
 # Name of final executable
 EXEC = 'burrowbun'
 
+# Names of other executables, each built from tools/<name>.cc
+TOOLS = ['worldgen']
+
+# Names of test programs, each built from <name>.cc in the top folder
+TESTS = ['collider_tests', 'mapgen_tests', 'slotmap_tests', 'map_tests']
+
 CLANG = 'clang-tidy-8'
 
 if __name__ == '__main__':
     if len(sys.argv) >= 2 and sys.argv[1] == 'lint':
         lint(CLANG)
+    elif len(sys.argv) >= 2 and sys.argv[1] in TOOLS:
+        build_tool(sys.argv[1])
+    elif len(sys.argv) >= 2 and sys.argv[1] in TESTS:
+        build_tool(sys.argv[1], tool_dir='.')
     else:
         build(EXEC)
@@ -0,0 +1,133 @@
+/* Make sure SlotMap keeps track of what's in it. Things get put in and taken
+out at random, and the slot map is checked against a plain list of what
+should be in there, oldest first. */
+
+#define CATCH_CONFIG_MAIN // Tells catch to provide a main()
+#include "catch.hpp"
+#include "src/util/SlotMap.hh"
+#include "src/util/Random.hh"
+
+#include <vector>
+
+#define VALUES 64
+
+/* What should be in the slot map, and the handle it was given. */
+struct Expected {
+    int *value;
+    SlotHandle handle;
+};
+
+/* Where the value is in the slot map, or -1 if it isn't there. */
+static int find(const SlotMap<int> &map, int *value) {
+    for (unsigned int i = 0; i < map.size(); i++) {
+        if (map[i] == value) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+TEST_CASE("slot map handles", "[slotmap]") {
+    int a = 0;
+    int b = 1;
+    int c = 2;
+    SlotMap<int> map;
+    REQUIRE(map.empty());
+
+    SlotHandle ha = map.insert(&a);
+    SlotHandle hb = map.insert(&b);
+    REQUIRE(map.size() == 2);
+    CHECK(map.get(ha) == &a);
+    CHECK(map.get(hb) == &b);
+
+    /* Taking out the first one moves the last one into its place. */
+    CHECK(map.eraseAt(0) == &a);
+    REQUIRE(map.size() == 1);
+    CHECK(map[0] == &b);
+    CHECK(!map.contains(ha));
+    CHECK(map.get(ha) == nullptr);
+    CHECK(map.get(hb) == &b);
+
+    /* The new one reuses a's slot, but a's handle still doesn't work. */
+    SlotHandle hc = map.insert(&c);
+    CHECK(hc.index == ha.index);
+    CHECK(!map.contains(ha));
+    CHECK(map.get(ha) == nullptr);
+    CHECK(map.get(hc) == &c);
+
+    /* b is older than c even though it was put in a slot later. */
+    CHECK(map[map.getOldest()] == &b);
+    CHECK(map.isOlder(find(map, &b), find(map, &c)));
+    CHECK(!map.isOlder(find(map, &c), find(map, &b)));
+
+    CHECK(map.erase(hb) == &b);
+    CHECK(!map.contains(hb));
+    CHECK(map.getHandle(0).index == hc.index);
+    CHECK(map.getHandle(0).generation == hc.generation);
+    CHECK(map[map.getOldest()] == &c);
+
+    CHECK(map.erase(hc) == &c);
+    CHECK(map.empty());
+}
+
+TEST_CASE("slot map matches a list", "[slotmap]") {
+    int values[VALUES];
+    SlotMap<int> map;
+    /* Oldest first. */
+    std::vector<Expected> expected;
+    /* Handles to things that have been taken out. */
+    std::vector<SlotHandle> stale;
+    RandomStream random(1);
+
+    for (int step = 0; step < 10000; step++) {
+        unsigned int choice = random.below(3);
+        if (expected.size() < VALUES && (choice == 0 || expected.empty())) {
+            /* Put in a value that isn't in there yet. */
+            int *value = &values[random.below(VALUES)];
+            while (find(map, value) != -1) {
+                value = &values[random.below(VALUES)];
+            }
+            expected.push_back({value, map.insert(value)});
+        }
+        else {
+            /* Take out something at random, by position or by handle. */
+            unsigned int k = random.below(expected.size());
+            int *value;
+            if (choice == 1) {
+                value = map.eraseAt(find(map, expected[k].value));
+            }
+            else {
+                value = map.erase(expected[k].handle);
+            }
+            CHECK(value == expected[k].value);
+            stale.push_back(expected[k].handle);
+            expected.erase(expected.begin() + k);
+        }
+
+        REQUIRE(map.size() == expected.size());
+        REQUIRE(map.empty() == expected.empty());
+        for (unsigned int k = 0; k < expected.size(); k++) {
+            int i = find(map, expected[k].value);
+            REQUIRE(i != -1);
+            CHECK(map.contains(expected[k].handle));
+            CHECK(map.get(expected[k].handle) == expected[k].value);
+            SlotHandle handle = map.getHandle(i);
+            CHECK(handle.index == expected[k].handle.index);
+            CHECK(handle.generation == expected[k].handle.generation);
+            if (k > 0) {
+                int older = find(map, expected[k - 1].value);
+                CHECK(map.isOlder(older, i));
+                CHECK(!map.isOlder(i, older));
+            }
+        }
+        if (!expected.empty()) {
+            CHECK(map[map.getOldest()] == expected[0].value);
+        }
+    }
+
+    /* Slots get reused, but never by something with the same generation. */
+    for (unsigned int k = 0; k < stale.size(); k++) {
+        CHECK(!map.contains(stale[k]));
+        CHECK(map.get(stale[k]) == nullptr);
+    }
+}
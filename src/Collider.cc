@@ -1,234 +1,375 @@
 #include <iostream>
+#include <cmath>
 #include "Collider.hh"
 
 // Number of updates to stand on a platform before dropping through
 #define PLATFORM_FALL_DELAY 4
 
+// How big the cells are for finding which entities are near each other
+#define ENTITY_CELL_SIZE 64
+
+// Bits in tileFlags
+#define TILE_FLAG_SOLID 1
+#define TILE_FLAG_PLATFORM 2
+#define TILE_FLAG_HURTS 4
+
 using namespace std;
 
 // Constructor
 Collider::Collider(int tileWidth, int tileHeight) : TILE_WIDTH(tileWidth),
-    TILE_HEIGHT(tileHeight) {
+    TILE_HEIGHT(tileHeight), itemHash(ITEM_MERGE_DISTANCE),
+    entityHash(ENTITY_CELL_SIZE) {
     // Or disable collisions to get a map viewer
     enableCollisions = true;
     xOffset = 1;
     yOffset = 1;
+    cache.width = 0;
+    cache.height = 0;
+}
+
+/* Round down, even for negative numbers. */
+static inline int floorDivide(int a, int b) {
+    assert(b > 0);
+    return a / b - (a % b < 0);
+}
+
+/* Set first and last to the lowest and highest tiles that overlap the line
+from start to start + length, if tile k goes from k * tileSize + offset to
+k * tileSize + offset + size. */
+static inline void overlapRange(int start, int length, int tileSize,
+        int offset, int size, int &first, int &last) {
+    first = floorDivide(start - offset - size, tileSize) + 1;
+    last = floorDivide(start + length - offset - 1, tileSize);
 }
 
-// Given that a collision happens left or right, update info accordingly.
-inline void Collider::findXCollision(CollisionInfo &info, int dx, 
-        int w, const Rect &stays) const {
-    // Collision is left or right
-    if (dx < 0) {
-        info.type = CollisionType::LEFT;
-        info.x = stays.x + stays.w;
+void Collider::fillCache(Map &map, const Rect &rect, int dx, int dy) {
+    /* Every tile the rect overlaps on the way, counting tiles as smaller by
+    the offsets. rowBlocks and columnBlocks start a tile further left and
+    down, but those tiles never overlap. */
+    cache.left = floorDivide(min(rect.x, rect.x + dx), TILE_WIDTH);
+    cache.bottom = floorDivide(min(rect.y, rect.y + dy), TILE_HEIGHT);
+    int right = floorDivide(max(rect.x, rect.x + dx) + rect.w, TILE_WIDTH);
+    int top = floorDivide(max(rect.y, rect.y + dy) + rect.h, TILE_HEIGHT);
+    cache.width = right - cache.left + 1;
+    cache.height = top - cache.bottom + 1;
+    cache.solid = 0;
+    cache.platform = 0;
+    cache.hurts = 0;
+    if (cache.width > TILE_CACHE_SIZE || cache.height > TILE_CACHE_SIZE) {
+        cache.width = 0;
+        cache.height = 0;
+        return;
     }
-    else {
-        info.type = CollisionType::RIGHT;
-        info.x = stays.x - w;
+
+    TileType row[TILE_CACHE_SIZE];
+    for (int j = 0; j < cache.height; j++) {
+        int y = cache.bottom + j;
+        /* Tiles above or below the map stay clear. */
+        if (y < 0 || y >= map.getHeight()) {
+            continue;
+        }
+        map.getForegroundRow(cache.left, y, cache.width, row);
+        for (int i = 0; i < cache.width; i++) {
+            uint64_t bit = (uint64_t)1 << (j * TILE_CACHE_SIZE + i);
+            uint8_t flags = tileFlags[(int)row[i]];
+            cache.solid |= (flags & TILE_FLAG_SOLID)? bit : 0;
+            cache.platform |= (flags & TILE_FLAG_PLATFORM)? bit : 0;
+            cache.hurts |= (flags & TILE_FLAG_HURTS)? bit : 0;
+        }
     }
+}
 
+uint8_t Collider::getFlags(Map &map, int x, int y) const {
+    unsigned int i = x - cache.left;
+    unsigned int j = y - cache.bottom;
+    if (i < (unsigned int)cache.width && j < (unsigned int)cache.height) {
+        uint64_t bit = (uint64_t)1 << (j * TILE_CACHE_SIZE + i);
+        return ((cache.solid & bit)? TILE_FLAG_SOLID : 0)
+            | ((cache.platform & bit)? TILE_FLAG_PLATFORM : 0)
+            | ((cache.hurts & bit)? TILE_FLAG_HURTS : 0);
+    }
+    assert(!tileFlags.empty());
+    TileType type;
+    map.getForegroundRow(x, y, 1, &type);
+    return tileFlags[(int)type];
 }
 
-// Given that a collision is up or down, update info accordingly
-inline void Collider::findYCollision(CollisionInfo &info, int dy, 
-        int h, const Rect &stays) const {
-    // Collision is up or down
-    if (dy < 0) {
-        info.type = CollisionType::DOWN;
-        info.y = stays.y + stays.h;
+bool Collider::blocks(Map &map, int x, int y, bool platforms) const {
+    if (y < 0 || y >= map.getHeight()) {
+        return false;
     }
-    else {
-        info.type = CollisionType::UP;
-        info.y = stays.y - h;
+    unsigned int i = x - cache.left;
+    unsigned int j = y - cache.bottom;
+    if (i < (unsigned int)cache.width && j < (unsigned int)cache.height) {
+        uint64_t bit = (uint64_t)1 << (j * TILE_CACHE_SIZE + i);
+        return (cache.solid & bit) || (platforms && (cache.platform & bit));
     }
+    x = (x % map.getWidth() + map.getWidth()) % map.getWidth();
+    const Tile *tile = map.getForeground(x, y);
+    return tile -> getIsSolid() || (platforms && tile -> getIsPlatform());
 }
 
-bool Collider::collidesTiles(const Rect &rect, Map &map) const {
-    /* Rect for tiles. */
-    Rect stays;
-    stays.worldWidth = TILE_WIDTH * map.getWidth();
-    stays.w = TILE_WIDTH;
-    stays.h = TILE_HEIGHT;
+bool Collider::columnBlocks(Map &map, int x, double y, int h) const {
+    int bottom = (int)floor(y / TILE_HEIGHT) - 1;
+    int top = (int)floor((y + h) / TILE_HEIGHT);
+    for (int j = bottom; j <= top; j++) {
+        /* Only count tiles it overlaps, not ones it just touches. */
+        if (y + h > j * TILE_HEIGHT + yOffset
+                && y < (j + 1) * TILE_HEIGHT - yOffset
+                && blocks(map, x, j, false)) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    /* width and height are how many tiles away to check for collisions
-    with tiles that it was already colliding with. */
-    int width = rect.w / TILE_WIDTH + 2;
-    int height = rect.h / TILE_HEIGHT + 2;
-    int startX = rect.x / TILE_WIDTH;
-    int startY = rect.y / TILE_HEIGHT;
-    // Collide with the tiles it starts on
-    for (int k = startX; k < startX + width; k++) {
-        /* Adjust so 0 <= l < map.getWidth() */
-        int l = (k + map.getWidth()) % map.getWidth();
-        stays.x = l * TILE_WIDTH + xOffset;
-        assert(0 <= stays.x);
-        assert(stays.x < stays.worldWidth);
-        for (int j = startY; j < startY + height; j++) {
-            stays.y = j * TILE_HEIGHT + yOffset;
-            assert(0 <= stays.y);
-            /* Ignore tiles that don't exist. */
-            if (!map.isOnMap(l, j)) {
-                break;
-            }
-            /* If the player starts off overlapping this tile */
-            if (stays.intersects(rect) && enableCollisions) {
-                /* Deal damage based on tile type. */
-                const Tile *tile = map.getForeground(l, j);
-                /* If the tile is solid, then there is a collision with a 
-                solid tile. */
-                if (tile -> getIsSolid()) {
-                    return true;
-                }
-            }
+bool Collider::rowBlocks(Map &map, int y, double x, int w, 
+        bool platforms) const {
+    int left = (int)floor(x / TILE_WIDTH) - 1;
+    int right = (int)floor((x + w) / TILE_WIDTH);
+    for (int i = left; i <= right; i++) {
+        if (x + w > i * TILE_WIDTH + xOffset
+                && x < (i + 1) * TILE_WIDTH - xOffset
+                && blocks(map, i, y, platforms)) {
+            return true;
         }
     }
-    /* None of the tiles were solid. */
     return false;
 }
 
-// Return information about a collision between a moving thing and a non-moving
-// thing. 
-CollisionInfo Collider::findCollision(const Rect &from, const Rect &to, 
-        const Rect &stays) const {
-    CollisionInfo info;
-    info.x = 0;
-    info.y = 0;
-    info.xCoefficient = 1;
-    info.yCoefficient = 1;
-    info.isInevitable = false;
-
-    int dx = to.x - from.x;
-    int dy = to.y - from.y;
-
-    // Check for collisions
-    if (stays.intersects(to)) {
-        // There's a collision.
-        // If exactly one of the sides didn't use to be in the collision area
-        // and now it is, we know the direction. (Actually, it can be two
-        // parallel ones, since we know velocity.)
-        // If the left or right side started off in the collision area
-        if (stays.intersectsX(from)) {
-            // Since this should only be called for things that didn't start 
-            // already colliding, we know neither y side started in the 
-            // collision area.
-            assert(!stays.intersectsY(from));
-            // Since there definately is a collision, it has to be up or down
-            assert(dy != 0);
-            findYCollision(info, dy, to.h, stays);
-            // Whether a collision happens doesn't depend on x velocity
-            info.isInevitable = true; 
-            return info;
+/* How far along a move of distance a rect that starts at start and is size
+long gets before it starts overlapping the row or column of tiles index. */
+static inline double entryTime(int start, int size, int distance,
+        int tileSize, int offset, int index) {
+    if (distance > 0) {
+        return (index * tileSize + offset - start - size) / (double)distance;
+    }
+    return (start - (index + 1) * tileSize + offset) / (double)-distance;
+}
+
+double Collider::nextTile(int start, int size, int distance, int tileSize,
+        int offset, int &index) const {
+    if (distance == 0) {
+        index = 0;
+        return 2;
+    }
+    /* The first row or column of tiles that it isn't already overlapping,
+    in the direction it's going. */
+    if (distance > 0) {
+        index = -floorDivide(offset - start - size, tileSize);
+    }
+    else {
+        index = floorDivide(start - tileSize + offset, tileSize);
+    }
+    return entryTime(start, size, distance, tileSize, offset, index);
+}
+
+SweepResult Collider::sweep(Map &map, const Rect &rect, int dx, int dy,
+        bool dropDown) const {
+    SweepResult result;
+    result.time = 1;
+    result.hitX = false;
+    result.hitY = false;
+    result.x = rect.x + dx;
+    result.y = rect.y + dy;
+
+    /* Platforms only stop things that are falling. */
+    bool platforms = dy < 0 && !dropDown;
+    int stepX = dx > 0? 1 : -1;
+    int stepY = dy > 0? 1 : -1;
+    int column;
+    int row;
+    double tx = nextTile(rect.x, rect.w, dx, TILE_WIDTH, xOffset, column);
+    double ty = nextTile(rect.y, rect.h, dy, TILE_HEIGHT, yOffset, row);
+
+    /* Go through the columns and rows it gets to in order. At each one, see
+    whether any of the tiles it would start overlapping are in the way. */
+    while (min(tx, ty) < 1) {
+        double t = min(tx, ty);
+        double x = rect.x + dx * t;
+        double y = rect.y + dy * t;
+        bool hitX = tx == t && columnBlocks(map, column, y, rect.h);
+        bool hitY = ty == t && rowBlocks(map, row, x, rect.w, platforms);
+        /* Running exactly into the corner of a tile counts as running into
+        its side, so it can be stepped up onto. */
+        if (tx == t && ty == t && !hitX && !hitY
+                && blocks(map, column, row, false)) {
+            hitX = true;
+        }
+
+        if (hitX || hitY) {
+            result.time = t;
+            result.hitX = hitX;
+            result.hitY = hitY;
+            /* Stop against whatever it hit, and otherwise round towards
+            where it started so it doesn't end up inside anything. */
+            result.x = rect.x + (int)(dx * t);
+            result.y = rect.y + (int)(dy * t);
+            if (hitX) {
+                result.x = dx > 0? column * TILE_WIDTH + xOffset - rect.w
+                    : (column + 1) * TILE_WIDTH - xOffset;
+            }
+            if (hitY) {
+                result.y = dy > 0? row * TILE_HEIGHT + yOffset - rect.h
+                    : (row + 1) * TILE_HEIGHT - yOffset;
+            }
+            return result;
         }
-        // If the top or bottom started off in the collision area
-        else if (stays.intersectsY(from)) {
-            // Likewise, we know it must be left or right
-            assert(dx != 0);
-            findXCollision(info, dx, to.w, stays);
-            // And whether it happens doesn't depend on y velocity
-            info.isInevitable = true;
-            return info;
+
+        if (tx == t) {
+            column += stepX;
+            tx = entryTime(rect.x, rect.w, dx, TILE_WIDTH, xOffset, column);
         }
-        // Now we know none of the edges started off in the collision area,
-        // so since we know there is a collision, there must be at least two
-        // edges in the collision area.
-        // Also for any of these cases isInevitable should stay false.
-        int tx = min(abs(from.x - stays.x - stays.w), 
-            abs(from.x - from.w - stays.x));
-        int ty = min(abs(from.y - stays.y - stays.h),
-            abs(from.y - from.h - stays.y));
-        // Multiplying is more efficient than dividing, and only their
-        // relative values matter anyway
-        tx *= abs(dy);
-        ty *= abs(dx);
-        if (tx < ty) {
-            // Collision is left or right
-            findXCollision(info, dx, to.w, stays);
+        if (ty == t) {
+            row += stepY;
+            ty = entryTime(rect.y, rect.h, dy, TILE_HEIGHT, yOffset, row);
         }
-        else if (ty < tx) {
-            // Collision is up or down
-            findYCollision(info, dy, to.h, stays);
+    }
+    return result;
+}
+
+MoveResult Collider::move(Map &map, Rect from, int dx, int dy,
+        bool dropDown) const {
+    int worldWidth = map.getWidth() * TILE_WIDTH;
+    int worldHeight = map.getHeight() * TILE_HEIGHT;
+    from.x = (from.x % worldWidth + worldWidth) % worldWidth;
+    MoveResult moved;
+    moved.hitX = false;
+    moved.hitDown = false;
+    moved.stopY = false;
+
+    /* Each time it hits something it stops going that way and keeps going
+    the other way, so this goes around at most three times. */
+    while (dx != 0 || dy != 0) {
+        /* The top and bottom of the map stop it too. */
+        int toY = from.y + dy;
+        int edgeY = min(max(toY, 0), worldHeight - from.h - 1);
+        SweepResult result;
+        if (enableCollisions) {
+            result = sweep(map, from, dx, edgeY - from.y, dropDown);
         }
-        // tx == ty and it's exactly hitting the corner
         else {
-            findXCollision(info, dx, to.w, stays);
-            if (info.type == CollisionType::LEFT) {
-                info.type = CollisionType::LEFT_CORNER;
-            }
-            else {
-                info.type = CollisionType::RIGHT_CORNER;
+            result.hitX = false;
+            result.hitY = false;
+            result.x = from.x + dx;
+            result.y = edgeY;
+        }
+        int toX = from.x + dx;
+        bool falling = edgeY < from.y;
+        from.x = result.x;
+        from.y = result.y;
+        dx = toX - from.x;
+        dy = toY - from.y;
+
+        if (result.hitX) {
+            moved.hitX = true;
+            dx = 0;
+        }
+        if (result.hitY || edgeY != toY) {
+            if (falling) {
+                moved.hitDown = true;
             }
+            moved.stopY = true;
+            dy = 0;
+        }
+        if (!result.hitX && !result.hitY) {
+            break;
         }
     }
-    else {
-        info.type = CollisionType::NONE;
+    if (from.y <= 0) {
+        moved.hitDown = true;
+        moved.stopY = true;
     }
 
-    return info;
+    // Wrap in the x direction
+    moved.x = (from.x + worldWidth) % worldWidth;
+    moved.y = from.y;
+    return moved;
 }
 
-/* Goes through the tiles near the player and adds all collisions found to 
-the vector collisions. If any are inevitable, it returns true. Otherwise, it
-returns false. If dropDown is true, it will ignore collisions with platforms.
-Note that to.x can be less than 0 or greater than worldWidth. */
-bool Collider::listCollisions(vector<CollisionInfo> &collisions, Map &map,
-    const Rect &to, const Rect &from, bool dropDown) const {
-    // The rectangle of the current tile to check
-    Rect stays;
-    stays.w = TILE_WIDTH - 2 * xOffset;
-    stays.h = TILE_HEIGHT - 2 * yOffset;
-    int worldWidth = map.getWidth() * TILE_WIDTH;
-    stays.worldWidth = worldWidth;
-
-    bool anyInevitable = false;
-
-    /* Only these tiles can be colliding, given that we're moving 
-    up to half a tilewidth and tileheight at a time and that we've already
-    checked for collisions with the tiles we started on. 
-    (Though it may miss a corner that was just barely hit) */
-    /* If to.x is negative, to.x / TILE_WIDTH will round in the wrong
-    direction. */
-    int toX = to.x + to.worldWidth;
-    for (int k = toX / TILE_WIDTH;
-            k < (toX + to.w) / TILE_WIDTH + 1; k++) {
-        int l = (k + map.getWidth()) % map.getWidth();
-        stays.x = l * TILE_WIDTH + xOffset;
-        for (int j = to.y / TILE_HEIGHT;
-                j < (to.y + to.h) / TILE_HEIGHT + 1; j++) {
-            // Don't collide with tiles not on the map
-            if (j < 0 || j >= map.getHeight()) {
-                continue;
-            }
-            const Tile *tile = map.getForeground(l, j);
-            // Skip non-collidable tiles
-            if (!(tile -> getIsSolid() || tile -> getIsPlatform())) {
-                continue;
-            }
-            // Skip platforms if we should drop through them
-            if (tile -> getIsPlatform() && dropDown) {
-                continue;
-            }
-            stays.y = j * TILE_HEIGHT + yOffset;
-            // Cases where they start off colliding should be dealt with
-            // elsewhere.
-            if (stays.intersects(from)) {
-                continue;
-            }
-            CollisionInfo info = findCollision(from, to, stays);
-            // Include information about what tile was collided
-            info.resolve(tile);
-
-            // Add this collision to the list to deal with later
-            // Also check whether any collision is inevitable
-            if (info.type != CollisionType::NONE) {
-                if (info.isInevitable) {
-                    anyInevitable = true;
-                }
-                collisions.push_back(info);
+bool Collider::overlapsSolid(Map &map, const Rect &rect) const {
+    int bottom = floorDivide(rect.y, TILE_HEIGHT) - 1;
+    int top = floorDivide(rect.y + rect.h, TILE_HEIGHT);
+    for (int j = bottom; j <= top; j++) {
+        if (rect.y + rect.h > j * TILE_HEIGHT + yOffset
+                && rect.y < (j + 1) * TILE_HEIGHT - yOffset
+                && rowBlocks(map, j, rect.x, rect.w, false)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+SweepResult Collider::raycast(Map &map, int x, int y, int dx, int dy) const {
+    /* A line is a rect with no width or height that doesn't stop for
+    platforms. */
+    Rect point;
+    point.worldWidth = map.getWidth() * TILE_WIDTH;
+    point.x = x;
+    point.y = y;
+    point.w = 0;
+    point.h = 0;
+    SweepResult result = sweep(map, point, dx, dy, true);
+    result.x = (result.x % point.worldWidth + point.worldWidth)
+        % point.worldWidth;
+    return result;
+}
+
+bool Collider::overlapsEntity(const Rect &rect,
+        const SlotMap<Entity> &entities) const {
+    for (unsigned int i = 0; i < entities.size(); i++) {
+        if (rect.intersects(entities[i] -> getRect())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Collider::tileOverlapsEntity(Map &map, int x, int y,
+        const SlotMap<Entity> &entities) const {
+    Rect rect;
+    rect.worldWidth = map.getWidth() * TILE_WIDTH;
+    rect.x = x * TILE_WIDTH + xOffset;
+    rect.y = y * TILE_HEIGHT + yOffset;
+    rect.w = TILE_WIDTH - 2 * xOffset;
+    rect.h = TILE_HEIGHT - 2 * yOffset;
+    return overlapsEntity(rect, entities);
+}
+
+bool Collider::collidesTiles(const Rect &rect, Map &map) const {
+    /* width and height are how many tiles away to check for collisions
+    with tiles that it was already colliding with. */
+    int width = rect.w / TILE_WIDTH + 2;
+    int height = rect.h / TILE_HEIGHT + 2;
+    int startX = rect.x / TILE_WIDTH;
+    int startY = rect.y / TILE_HEIGHT;
+    // Collide with the tiles it starts on
+    /* Only look at the tiles it overlaps. */
+    int firstX, lastX, firstY, lastY;
+    overlapRange(rect.x, rect.w, TILE_WIDTH, xOffset, TILE_WIDTH, firstX,
+        lastX);
+    overlapRange(rect.y, rect.h, TILE_HEIGHT, yOffset, TILE_HEIGHT, firstY,
+        lastY);
+    firstX = max(firstX, startX);
+    lastX = min(lastX, startX + width - 1);
+    firstY = max(firstY, startY);
+    /* Ignore tiles that don't exist. */
+    lastY = min(min(lastY, startY + height - 1), map.getHeight() - 1);
+    if (!enableCollisions) {
+        return false;
+    }
+    for (int k = firstX; k <= lastX; k++) {
+        assert(0 <= firstY * TILE_HEIGHT + yOffset);
+        for (int j = firstY; j <= lastY; j++) {
+            /* If the tile is solid, then there is a collision with a 
+            solid tile. */
+            if (getFlags(map, k, j) & TILE_FLAG_SOLID) {
+                return true;
             }
         }
     }
-    return anyInevitable; 
+    /* None of the tiles were solid. */
+    return false;
 }
 
 //  A function that moves a movable to where it should end up on a map. This 
@@ -239,16 +380,12 @@ bool Collider::listCollisions(vector<CollisionInfo> &collisions, Map &map,
 // it's best to call it again with the results assuming the y position is 
 // correct but the x may have farther to move.
 void Collider::collide(Map &map, movable::Movable &movable) {
-    // Calculate the world width and height
+    // Calculate the world width
     int worldWidth = map.getWidth() * TILE_WIDTH;
-    int worldHeight = map.getHeight() * TILE_HEIGHT;
 
-    // from is the rectangle of the player the update before, to is the 
-    // rectangle the player would move to if it didn't collide with anything,
-    // and stays is the tile currently being checked for collisions with the
-    // player.
+    // from is the rectangle of the player as it moves, and stays is the
+    // tile currently being checked for collisions with the player.
     Rect from;
-    Rect to;
     Rect stays;
 
     /* Set the height and width of the rectangle that will hold each tile. */
@@ -256,22 +393,16 @@ void Collider::collide(Map &map, movable::Movable &movable) {
     stays.h = TILE_HEIGHT - 2 * yOffset;
     assert(0 <= stays.w);
     assert(0 <= stays.h);
-    stays.worldWidth = worldWidth;
 
     /* Set the starting location and the width and height. */
     from = movable.getRect();
     from.worldWidth = worldWidth;
     from.x = (from.x + worldWidth) % worldWidth;
-    to = movable.getRect();
-    to.worldWidth = worldWidth;
 
     assert(0 <= from.y);
     assert(0 <= from.w);
     assert(0 <= from.h);
 
-    assert(0 <= to.w);
-    assert(0 <= to.h);
-
     // Collide with tiles
     /* width and height are how many tiles away to check for collisions
     with tiles that it was already colliding with. */
@@ -282,153 +413,56 @@ void Collider::collide(Map &map, movable::Movable &movable) {
     int startX = from.x / TILE_WIDTH;
     int startY = from.y / TILE_HEIGHT; 
     // Collide with the tiles it starts on
-    for (int k = startX; k < startX + width; k++) {
+    /* Only look at the tiles it overlaps, counting tiles as smaller by the
+    offsets. */
+    int firstX, lastX, firstY, lastY;
+    overlapRange(from.x, from.w, TILE_WIDTH, xOffset, stays.w, firstX, lastX);
+    overlapRange(from.y, from.h, TILE_HEIGHT, yOffset, stays.h, firstY, lastY);
+    firstX = max(firstX, startX);
+    lastX = min(lastX, startX + width - 1);
+    firstY = max(firstY, startY);
+    /* Ignore tiles that don't exist. */
+    lastY = min(min(lastY, startY + height - 1), map.getHeight() - 1);
+    for (int k = firstX; k <= lastX && enableCollisions; k++) {
         /* Adjust so 0 <= l < map.getWidth() */
         int l = (k + map.getWidth()) % map.getWidth();
-        stays.x = l * TILE_WIDTH + xOffset;
-        assert(0 <= stays.x);
-        assert(stays.x < worldWidth);
-        for (int j = startY; j < startY + height; j++) {
-            stays.y = j * TILE_HEIGHT + yOffset;
-            assert(0 <= stays.y);
-            /* Ignore tiles that don't exist. */
-            if (!map.isOnMap(l, j)) {
-                break;
+        for (int j = firstY; j <= lastY; j++) {
+            uint8_t flags = getFlags(map, k, j);
+            /* Deal damage based on tile type. */
+            if (flags & TILE_FLAG_HURTS) {
+                map.getForeground(l, j) -> dealOverlapDamage(movable);
             }
-            /* If the player starts off overlapping this tile */
-            if (stays.intersects(from) && enableCollisions) {
-                /* Deal damage based on tile type. */
-                const Tile *tile = map.getForeground(l, j);
-                tile -> dealOverlapDamage(movable);
-                /* If the tile is solid, set velocity to 0. */
-                if (tile -> getIsSolid()) {
-                    xVelocity = 0;
-                    yVelocity = 0;
-                    /* But also actually set the movable's velocity. */
-                    movable.setVelocity({0, 0});
-                }
+            /* If the tile is solid, set velocity to 0. */
+            if (flags & TILE_FLAG_SOLID) {
+                xVelocity = 0;
+                yVelocity = 0;
+                /* But also actually set the movable's velocity. */
+                movable.setVelocity({0, 0});
             }
         }
     }
 
     // Collide with tiles it doesn't start on
-    double xCoefficient = 1;
-    double yCoefficient = 1;
-    while (xVelocity != 0 || yVelocity != 0) {
-        // The n is in case moludo results in 0 inconveniently
-        int n = max(min(1, xVelocity), -1);
-        int dx = (xVelocity - n) % (TILE_WIDTH / 2) + n;
-        n = max(min(1, yVelocity), -1);
-        int dy = (yVelocity - n) % (TILE_HEIGHT / 2) + n;
-        to.x = from.x + dx;
-        to.y = from.y + dy;
-        /* Collide with the bottom and top of the map. */
-        movable.isCollidingDown = to.collideEdge(worldHeight);
-        /* If there was a collision with the bottom or top of the map,
-        set velocity to 0. */
-        if (movable.isCollidingDown) {
-            movable::Point velocity = movable.getVelocity();
-            velocity.y = 0;
-            movable.setVelocity(velocity);
-        }
-
-        int newX = from.x;
-        int newY = from.y;
-        // A separate variable so that corner collisions can only happen if
-        // no other collisions happen.
-        int cornerX = to.x;
-        assert(abs(xVelocity - dx) <= abs(xVelocity));
-        assert(abs(yVelocity - dy) <= abs(yVelocity));
-        xVelocity -= dx;
-        yVelocity -= dy;
-        // Check whether there are andy inevitable collisions we should 
-        // handle first (they do need to be first, otherwise the player can
-        // climb walls).
-        bool anyInevitable = false;
-        // Make a list of all collisions between the movable and any tiles 
-        vector<CollisionInfo> collisions;
-        // Whether we should drop down through platforms
-        bool dropDown = movable.isDroppingDown
-            && (movable.ticksCollidingDown >= PLATFORM_FALL_DELAY);
-        anyInevitable = listCollisions(collisions, map, to, from, dropDown);
-
-        // Only collide if collisions are enabled
-        while (enableCollisions && (collisions.size() != 0)) {
-           // And actually handle the collisions
-            for (unsigned int i = 0; i < collisions.size(); i++) {
-                CollisionInfo info = collisions[i];
-                // Skip this one if necessary
-                if (anyInevitable && (!info.isInevitable)) {
-                    continue;
-                }
-                xCoefficient *= info.xCoefficient;
-                yCoefficient *= info.yCoefficient;
-                if (info.newX != -1) {
-                    newX = info.newX;
-                    movable.isCollidingX = true;
-                }
-                if (info.type == CollisionType::DOWN) {
-                    movable.isCollidingDown = true;
-                }
-                if (info.newY != -1) {
-                    newY = info.newY;
-                }
-                if (info.cornerX != -1) {
-                    cornerX = info.cornerX;
-                }
-            }
-
-            // If there weren't any inevitable collisions, handle corner 
-            // collisions and restart
-            // Only check for corner collisions when there were no others
-            bool usedCorner = false;
-            if (!anyInevitable && xCoefficient != 0 && yCoefficient != 0) {
-                movable.isCollidingX = true;
-                newX = cornerX;
-                xCoefficient = 0;
-                usedCorner = true;
-            }
- 
-            // Move the rest of the way
-            dx = to.x - newX;
-            dy = to.y - newY;
-            dx *= xCoefficient;
-            dy *= yCoefficient;
-            xVelocity *= xCoefficient;
-            yVelocity *= yCoefficient;
-
-            // And repeat until we're done
-            from.x = newX;
-            from.y = newY;
-            to.x = from.x + dx;
-            to.y = from.y + dy;
-
-           if (!anyInevitable && !usedCorner) {
-                // This actually happens surprisingly rarely
-                break;
-            }
-            else {
-            }
-            // Otherwise, check again for collisions.
-            collisions.clear();
-            anyInevitable = listCollisions(collisions, map, to, from, dropDown);
-        }
-
-        // Set to where we're actaully moving to.
-        from.x = to.x;
-        from.y = to.y;
+    // Whether we should drop down through platforms
+    bool dropDown = movable.isDroppingDown
+        && (movable.ticksCollidingDown >= PLATFORM_FALL_DELAY);
+    MoveResult moved = move(map, from, xVelocity, yVelocity, dropDown);
+    if (moved.hitX) {
+        movable.isCollidingX = true;
+    }
+    if (moved.hitDown) {
+        movable.isCollidingDown = true;
     }
+
     // If there were collisions, set the velocity to 0
     // But only in the x direction because otherwise it breaks stepping up
+    double yCoefficient = moved.stopY? 0 : 1;
     movable::Point velocity = movable.getVelocity();
     velocity.y *= yCoefficient;
     movable.setVelocity(velocity);
 
-    movable.setX(from.x);
-    movable.setY(from.y);
-    // Collide with the edge of the map
-    // Wrap in the x direction
-    movable.setX((movable.getRect().x + worldWidth) % worldWidth);
+    movable.setX(moved.x);
+    movable.setY(moved.y);
 
     /* Now time to see if we can update the movable's collision rect. */
     Rect nextRect = movable.getNextRect();
@@ -444,13 +478,19 @@ void Collider::collide(Map &map, movable::Movable &movable) {
 }
 
 
+PhysicsSample Collider::getPhysics(Map &map, const Rect &rect) const {
+    int x = (rect.x + rect.w / 2) / TILE_WIDTH;
+    int y = (rect.y + rect.h / 2) / TILE_HEIGHT;
+    return map.getPhysics(x, y);
+}
+
 void Collider::updateMovable(Map &map, movable::Movable *movable) {
     // Update the velocity
+    movable -> updateMotion(getPhysics(map, movable -> getRect()));
+    moveMovable(map, movable);
+}
 
-    // TODO: replace this with gravity as a function of height and map
-    double gravity = -1.5;
-    movable -> updateMotion(gravity);
-
+void Collider::moveMovable(Map &map, movable::Movable *movable) {
     if (!movable -> collides) {
         movable -> setX(movable -> getRect().x + movable -> getVelocity().x);
         movable -> setY(movable -> getRect().y + movable -> getVelocity().y);
@@ -459,6 +499,14 @@ void Collider::updateMovable(Map &map, movable::Movable *movable) {
 
     // toX is the x value the movable expects to end up having.
     int toX = movable -> getRect().x + movable -> getVelocity().x;
+    /* Everything below looks at the tiles along the way, and stepping up
+    looks at the ones up to a tile higher. */
+    Rect from = movable -> getRect();
+    int worldWidth = map.getWidth() * TILE_WIDTH;
+    from.x = (from.x + worldWidth) % worldWidth;
+    from.h += TILE_HEIGHT;
+    fillCache(map, from, movable -> getVelocity().x,
+        movable -> getVelocity().y);
     collide(map, *movable);
     // Because collide() may stop things in the x direction before it 
     // should, we should try again.
@@ -479,11 +527,14 @@ void Collider::updateMovable(Map &map, movable::Movable *movable) {
     // Do the thing where colliding with a wall one block high doesn't
     // stop you
     if (movable -> isCollidingX) {
-        movable::Movable hypothetical(*(movable));
-        /* Don't have hypothetical change collision rect. */
-        hypothetical.resetRect();
+        Rect rect = movable -> getRect();
+        rect.worldWidth = map.getWidth() * TILE_WIDTH;
+        /* Something stuck inside a tile can't step anywhere. */
+        if (enableCollisions && overlapsSolid(map, rect)) {
+            return;
+        }
         // See if it can go up one tile or less without colliding
-        int oldY = hypothetical.getRect().y;
+        int oldY = rect.y;
         // The amount to move by to go up one tile or less, assuming 
         // gravity is in the usual direction
         // TODO: it probably doesn't matter, but this is inaccurate when 
@@ -491,24 +542,27 @@ void Collider::updateMovable(Map &map, movable::Movable *movable) {
         int dy = TILE_HEIGHT - ((oldY + yOffset)  % TILE_HEIGHT);
         assert(dy <= TILE_HEIGHT);
         assert(dy > 0);
-        hypothetical.setVelocity({0, (double)dy});
-        collide(map, hypothetical);
+        MoveResult up = move(map, rect, 0, dy, false);
         // If there wasn't a collision
-        if (hypothetical.getRect().y == oldY + dy) {
-            assert(hypothetical.getRect().x == movable -> getRect().x);
+        if (up.y == oldY + dy) {
+            assert(up.x == movable -> getRect().x);
             assert(movable -> getRect().y == oldY);
             // check that it would end up standing on the tile, and not 
             // randomly jump up and fall back down
             // dx is how much more it could have gone in the x direction, 
             // if it didn't collide with the tile it's stepping up
-            int dx = toX - hypothetical.getRect().x;
-            hypothetical.setVelocity({(double)dx, 0});
-            collide(map, hypothetical);
-            if (hypothetical.getRect().x != movable -> getRect().x) {
+            rect.x = up.x;
+            rect.y = up.y;
+            int dx = toX - rect.x;
+            MoveResult across = up;
+            if (!enableCollisions || !overlapsSolid(map, rect)) {
+                across = move(map, rect, dx, 0, false);
+            }
+            if (across.x != movable -> getRect().x) {
                 // Ok, so we do want to jump up and continue
                 // doing that instantaneously would look like:
-                // movables[i] -> x = hypothetical.x;
-                // movables[i] -> y = hypothetical.y;
+                // movables[i] -> x = across.x;
+                // movables[i] -> y = across.y;
                 // but we actually only want to go up by one x velocity
                 // (not one y velocity because the whole point of this is 
                 // that you go up without jumping).
@@ -517,8 +571,8 @@ void Collider::updateMovable(Map &map, movable::Movable *movable) {
                 on the tile it's stepping up to. */
                 if (dy < abs(movable -> getVelocity().x)
                             || movable -> getRect().y < TILE_HEIGHT) {
-                    movable -> setX(hypothetical.getRect().x);
-                    movable -> setY(hypothetical.getRect().y);
+                    movable -> setX(across.x);
+                    movable -> setY(across.y);
                 }
                 /* Else it will go partway up and temporarily ignore
                 gravity. */
@@ -532,51 +586,285 @@ void Collider::updateMovable(Map &map, movable::Movable *movable) {
     }
 }
 
+void ItemBodies::resize(unsigned int size) {
+    x.resize(size);
+    y.resize(size);
+    w.resize(size);
+    h.resize(size);
+    vx.resize(size);
+    vy.resize(size);
+    ax.resize(size);
+    ay.resize(size);
+    gravity.resize(size);
+    dragX.resize(size);
+    dragY.resize(size);
+    maxHeight.resize(size);
+    pixelsFallen.resize(size);
+    ticksCollidingDown.resize(size);
+    timeOffGround.resize(size);
+    flags.resize(size);
+}
+
+void Collider::updateItems(Map &map, SlotMap<DroppedItem> &droppedItems) {
+    unsigned int size = droppedItems.size();
+    bodies.resize(size);
+
+    /* Copy out the numbers the physics needs. */
+    for (unsigned int i = 0; i < size; i++) {
+        const DroppedItem *item = droppedItems[i];
+        assert(item -> drag.x == ITEM_DRAG_X);
+        assert(item -> drag.y == ITEM_DRAG_Y);
+        assert(item -> minVelocity == 0);
+        Rect rect = item -> getRect();
+        bodies.x[i] = rect.x;
+        bodies.y[i] = rect.y;
+        bodies.w[i] = rect.w;
+        bodies.h[i] = rect.h;
+        bodies.vx[i] = item -> velocity.x;
+        bodies.vy[i] = item -> velocity.y;
+        bodies.ax[i] = item -> accel.x;
+        bodies.ay[i] = item -> accel.y;
+        PhysicsSample physics = getPhysics(map, rect);
+        bodies.gravity[i] = physics.gravity;
+        bodies.dragX[i] = ITEM_DRAG_X * physics.dragX;
+        bodies.dragY[i] = ITEM_DRAG_Y * physics.dragY;
+        bodies.maxHeight[i] = item -> maxHeight;
+        bodies.pixelsFallen[i] = item -> pixelsFallen;
+        bodies.ticksCollidingDown[i] = item -> ticksCollidingDown;
+        bodies.timeOffGround[i] = item -> timeOffGround;
+        bodies.flags[i] = (item -> gravity? BODY_GRAVITY : 0)
+            | (item -> collides? BODY_COLLIDES : 0)
+            | (item -> isSteppingUp? BODY_STEPPING_UP : 0)
+            | (item -> isCollidingX? BODY_COLLIDING_X : 0)
+            | (item -> isCollidingDown? BODY_COLLIDING_DOWN : 0)
+            | (item -> isDroppingDown? BODY_DROPPING_DOWN : 0)
+            | (item -> collidePlatforms? BODY_COLLIDE_PLATFORMS : 0);
+    }
+
+    /* Update the velocities. This is Movable::updateMotion, but for every
+    item at once. */
+    int *y = bodies.y.data();
+    double *vx = bodies.vx.data();
+    double *vy = bodies.vy.data();
+    const double *ax = bodies.ax.data();
+    const double *ay = bodies.ay.data();
+    const double *gravity = bodies.gravity.data();
+    const double *dragX = bodies.dragX.data();
+    const double *dragY = bodies.dragY.data();
+    int *maxHeight = bodies.maxHeight.data();
+    int *pixelsFallen = bodies.pixelsFallen.data();
+    int *ticksCollidingDown = bodies.ticksCollidingDown.data();
+    int *timeOffGround = bodies.timeOffGround.data();
+    uint8_t *flags = bodies.flags.data();
+    for (unsigned int i = 0; i < size; i++) {
+        bool down = flags[i] & BODY_COLLIDING_DOWN;
+        pixelsFallen[i] = down? maxHeight[i] - y[i] : 0;
+        maxHeight[i] = down? y[i] : max(maxHeight[i], y[i]);
+        ticksCollidingDown[i] = down? ticksCollidingDown[i] + 1 : 0;
+        timeOffGround[i] = down? 0 : timeOffGround[i] + 1;
+
+        bool falls = (flags[i] & (BODY_GRAVITY | BODY_STEPPING_UP))
+            == BODY_GRAVITY;
+        vx[i] = (vx[i] + ax[i]) * dragX[i];
+        vy[i] = (vy[i] + ay[i] + (falls? gravity[i] : 0)) * dragY[i];
+        vx[i] = (-1 < vx[i] && vx[i] < 1)? 0 : vx[i];
+        vy[i] = (-1 < vy[i] && vy[i] < 1 && !falls)? 0 : vy[i];
+        maxHeight[i] = vy[i] > 0? min(maxHeight[i], y[i]) : maxHeight[i];
+
+        bool dropping = down && !(flags[i] & BODY_COLLIDE_PLATFORMS);
+        flags[i] &= BODY_GRAVITY | BODY_COLLIDES | BODY_COLLIDE_PLATFORMS;
+        flags[i] |= dropping? BODY_DROPPING_DOWN : 0;
+    }
+
+    /* Move them through the map. Items that start inside something or run
+    into a wall get left where they are for now. */
+    int worldWidth = map.getWidth() * TILE_WIDTH;
+    blocked.clear();
+    for (unsigned int i = 0; i < size; i++) {
+        if (!(flags[i] & BODY_COLLIDES)) {
+            bodies.x[i] = bodies.x[i] + vx[i];
+            y[i] = y[i] + vy[i];
+            continue;
+        }
+        Rect from;
+        from.worldWidth = worldWidth;
+        from.x = (bodies.x[i] + worldWidth) % worldWidth;
+        from.y = y[i];
+        from.w = bodies.w[i];
+        from.h = bodies.h[i];
+        fillCache(map, from, (int)vx[i], (int)vy[i]);
+        if (enableCollisions && overlapsSolid(map, from)) {
+            blocked.push_back(i);
+            continue;
+        }
+        bool dropDown = (flags[i] & BODY_DROPPING_DOWN)
+            && ticksCollidingDown[i] >= PLATFORM_FALL_DELAY;
+        MoveResult moved = move(map, from, (int)vx[i], (int)vy[i],
+            dropDown);
+        if (moved.hitX) {
+            blocked.push_back(i);
+            continue;
+        }
+        bodies.x[i] = moved.x;
+        y[i] = moved.y;
+        flags[i] |= moved.hitDown? BODY_COLLIDING_DOWN : 0;
+        vy[i] *= moved.stopY? 0 : 1;
+    }
+
+    /* Copy the numbers back. */
+    for (unsigned int i = 0; i < size; i++) {
+        DroppedItem *item = droppedItems[i];
+        item -> setX(bodies.x[i]);
+        item -> setY(y[i]);
+        item -> velocity.x = vx[i];
+        item -> velocity.y = vy[i];
+        item -> maxHeight = maxHeight[i];
+        item -> pixelsFallen = pixelsFallen[i];
+        item -> ticksCollidingDown = ticksCollidingDown[i];
+        item -> timeOffGround = timeOffGround[i];
+        item -> isSteppingUp = false;
+        item -> isCollidingX = false;
+        item -> isCollidingDown = flags[i] & BODY_COLLIDING_DOWN;
+        item -> isDroppingDown = flags[i] & BODY_DROPPING_DOWN;
+    }
+
+    /* Anything that ran into something gets moved the usual way, which
+    handles starting inside tiles and stepping up onto them. */
+    for (unsigned int i = 0; i < blocked.size(); i++) {
+        moveMovable(map, droppedItems[blocked[i]]);
+    }
+}
+
+void Collider::collideEntities(Map &map, SlotMap<Entity> &entities) {
+    int worldWidth = map.getWidth() * TILE_WIDTH;
+    entityHash.clear(worldWidth);
+    for (unsigned int i = 0; i < entities.size(); i++) {
+        entityHash.insert(i, entities[i] -> getRect());
+    }
+    entityHash.finish();
+
+    /* Find everything before doing anything, so getting knocked back by
+    one thing doesn't change what else it hits. */
+    touching.clear();
+    for (unsigned int i = 0; i < entities.size(); i++) {
+        Rect rect = entities[i] -> getRect();
+        entityHash.query(rect, nearby);
+        for (unsigned int j = 0; j < nearby.size(); j++) {
+            if ((unsigned int)nearby[j] > i
+                    && rect.intersects(entities[nearby[j]] -> getRect())) {
+                touching.emplace_back(i, nearby[j]);
+            }
+        }
+    }
+
+    hitboxes.clear();
+    for (unsigned int i = 0; i < entities.size(); i++) {
+        hitboxes.insert(hitboxes.end(), entities[i] -> hitboxes.begin(),
+            entities[i] -> hitboxes.end());
+        entities[i] -> hitboxes.clear();
+    }
+    hits.clear();
+    for (unsigned int i = 0; i < hitboxes.size(); i++) {
+        hitboxes[i].rect.worldWidth = worldWidth;
+        entityHash.query(hitboxes[i].rect, nearby);
+        for (unsigned int j = 0; j < nearby.size(); j++) {
+            const Entity *entity = entities[nearby[j]];
+            if (entity != hitboxes[i].owner
+                    && hitboxes[i].rect.intersects(entity -> getRect())) {
+                hits.emplace_back(i, nearby[j]);
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i < touching.size(); i++) {
+        Entity *first = entities[touching[i].first];
+        Entity *second = entities[touching[i].second];
+        first -> touch(*second);
+        second -> touch(*first);
+    }
+    for (unsigned int i = 0; i < hits.size(); i++) {
+        entities[hits[i].second] -> hit(hitboxes[hits[i].first]);
+    }
+}
+
 // A function to move and collide the movables
 // Note that this only ever resets distance fallen when it hits the ground.
-void Collider::update(Map &map, vector<Entity *> &entities,
-        vector<DroppedItem *> droppedItems) {
+void Collider::update(Map &map, SlotMap<Entity> &entities,
+        SlotMap<DroppedItem> &droppedItems) {
+    int worldWidth = map.getWidth() * map.getTileWidth();
+
+    /* Which types of tile stop things is up to the map. */
+    tileFlags.resize((int)TileType::LAST_TILE + 1);
+    for (unsigned int i = 0; i < tileFlags.size(); i++) {
+        tileFlags[i] = (map.isSolid((TileType)i)? TILE_FLAG_SOLID : 0)
+            | (map.isPlatform((TileType)i)? TILE_FLAG_PLATFORM : 0)
+            | (map.dealsOverlapDamage((TileType)i)? TILE_FLAG_HURTS : 0);
+    }
+
     /* Update dropped items. This needs to happen between when map collisions
     get handled and when things try to attract dropped items. */
     for (unsigned int i = 0; i < droppedItems.size(); i++) {
         droppedItems[i] -> update();
     }
 
+    /* Sort the items by where they are, so each thing only looks at the
+    items close enough to matter. */
+    itemHash.clear(worldWidth);
+    for (unsigned int i = 0; i < droppedItems.size(); i++) {
+        itemHash.insert(i, droppedItems[i] -> getRect());
+    }
+    itemHash.finish();
+
     // Have entities with inventories pick up dropped items if they can
     for (unsigned int i = 0; i < entities.size(); i++) {
         // Make sure worldwith is updated correctly
-        entities[i] -> setWorldwidth(map.getWidth() * map.getTileWidth());
+        entities[i] -> setWorldwidth(worldWidth);
 
         // Skip things that can't pick up items
         if (!entities[i] -> getHasInventory()) {
             continue;
         }
 
-        // Check for each item
-        for (unsigned int j = 0; j < droppedItems.size(); j++) {
-            entities[i] -> pickup(droppedItems[j]);
+        // Check for each item near enough
+        itemHash.query(entities[i] -> getRectDist(
+            entities[i] -> getPickupDistance()), nearby);
+        for (unsigned int j = 0; j < nearby.size(); j++) {
+            entities[i] -> pickup(droppedItems[nearby[j]]);
         }
     }
 
     // Have dropped items try to merge with each other
     for (unsigned int i = 0; i < droppedItems.size(); i++) {
-        for (unsigned int j = i + 1; j < droppedItems.size(); j++) {
-            /* Merging in this order means the older item will still be at 
-            the front of the vector. */
-            droppedItems[j] -> merge(droppedItems[i]);
+        itemHash.query(droppedItems[i] -> getRectDist(ITEM_MERGE_DISTANCE),
+            nearby);
+        for (unsigned int j = 0; j < nearby.size(); j++) {
+            /* Only merge each pair once. Positions don't say which item is
+            older, so ask the slot map, and merge the newer item into the
+            older one so that the stack keeps its place in line to despawn. */
+            unsigned int other = (unsigned int)nearby[j];
+            if (other <= i) {
+                continue;
+            }
+            if (droppedItems.isOlder(i, other)) {
+                droppedItems[i] -> merge(droppedItems[other]);
+            }
+            else {
+                droppedItems[other] -> merge(droppedItems[i]);
+            }
         }
     }
 
-    // TODO: collide entities and attackboxes
+    collideEntities(map, entities);
 
     // Update the velocity of everythingdelete
     for (unsigned i = 0; i < entities.size(); i++) {
         updateMovable(map, (movable::Movable *)entities[i]);
     }
 
-    for (unsigned i = 0; i < droppedItems.size(); i++) {
-        updateMovable(map, (movable::Movable *)droppedItems[i]);
-    }
+    updateItems(map, droppedItems);
 
+    /* The map can change before next time, so anything asked from outside
+    has to look at the map itself. */
+    cache.width = 0;
+    cache.height = 0;
 }
-
@@ -4,81 +4,100 @@
 #include <iostream>
 #include <cassert>
 #include <vector>
+#include <cstdint>
 #include "world/Tile.hh"
 #include "world/Map.hh"
 #include "entity/Movable.hh"
 #include "Rect.hh"
 #include "entity/DroppedItem.hh"
 #include "entity/Entity.hh"
+#include "util/SpatialHash.hh"
 
-/* To be able to describe collisions better. */
-enum class CollisionType {
-    NONE,
-    UP,
-    DOWN,
-    LEFT,
-    RIGHT,
-    LEFT_CORNER,
-    RIGHT_CORNER
+/* Where a rectangle moving in a straight line first runs into a tile. */
+struct SweepResult {
+    /* How far along the move it got before hitting something, from 0 to 1.
+    It's 1 if it didn't hit anything. */
+    double time;
+
+    /* Whether it hit something going sideways, and going up or down. */
+    bool hitX;
+    bool hitY;
+
+    /* Where it ends up. */
+    int x;
+    int y;
 };
 
-/* A struct containing a collision type, a pointer to the relevant Tile, and
-   the distance to the collision. */
-struct CollisionInfo {
-    /* The locations of the edges of the tile that could be being collided
-    with, based on the direction the movable is moving, adjusted so their 
-    distance from the bottom left corner of the movable is the same as,
-    pre-adjustement, the distance from the edge to whichever edge of the 
-    movable would collide with them had been. 
-    This ends up being the movable's location plus the distance to the 
-    collision in each direction. */
+/* Where a rectangle ends up after moving through the map, stopping at tiles
+and at the top and bottom of the map. */
+struct MoveResult {
+    /* Where it ends up, with x wrapped to be on the map. */
     int x;
     int y;
-    CollisionType type;
-    // Whether other collisions can prevent this one
-    bool isInevitable;
-    // For resolving the collision
-    int xCoefficient;
-    int yCoefficient;
-    int newX;
-    int newY;
-    int cornerX;
-
-    // Resolve a collision
-    void resolve(Tile const *tile) {
-        newX = -1;
-        newY = -1;
-        cornerX = -1;
-        switch(type) {
-            case CollisionType::DOWN :
-                yCoefficient *= (int)(!(tile -> getIsPlatform()));
-                // Purposely no break
-            case CollisionType::UP :
-                newY = y;
-                yCoefficient *= (int)(!(tile -> getIsSolid()));
-                break;
-            case CollisionType::LEFT :
-            case CollisionType::RIGHT :
-                newX = x;
-                if (tile -> getIsSolid()) {
-                    xCoefficient = 0;
-                }
-                break;
-            case CollisionType::LEFT_CORNER :
-            case CollisionType::RIGHT_CORNER :
-                if (tile -> getIsSolid()) {
-                    cornerX = x;
-                }
-                break;
-            case CollisionType::NONE :
-                break;
-            }
-            // Ignore collisions with platforms from most directions
-            if (tile -> getIsPlatform() && type != CollisionType::DOWN) {
-                type = CollisionType::NONE;
-            }
-        }
-    
+
+    /* Whether it ran into something sideways, and whether it landed on
+    something. */
+    bool hitX;
+    bool hitDown;
+
+    /* Whether it ran into something going up or down, so it should stop
+    going that way. */
+    bool stopY;
+};
+
+/* Bits for ItemBodies::flags. */
+#define BODY_GRAVITY 1
+#define BODY_COLLIDES 2
+#define BODY_STEPPING_UP 4
+#define BODY_COLLIDING_X 8
+#define BODY_COLLIDING_DOWN 16
+#define BODY_DROPPING_DOWN 32
+#define BODY_COLLIDE_PLATFORMS 64
+
+/* The numbers the physics needs for each dropped item, with an array for
+each number instead of a struct for each item. There are lots of dropped
+items and they all move the same way, apart from the physics of where they
+are, so they can be gone through all at once in a tight loop. They're copied
+out of the items at the start of the tick and back at the end. */
+struct ItemBodies {
+    std::vector<int> x;
+    std::vector<int> y;
+    std::vector<int> w;
+    std::vector<int> h;
+    std::vector<double> vx;
+    std::vector<double> vy;
+    std::vector<double> ax;
+    std::vector<double> ay;
+    std::vector<double> gravity;
+    std::vector<double> dragX;
+    std::vector<double> dragY;
+    std::vector<int> maxHeight;
+    std::vector<int> pixelsFallen;
+    std::vector<int> ticksCollidingDown;
+    std::vector<int> timeOffGround;
+    std::vector<uint8_t> flags;
+
+    void resize(unsigned int size);
+};
+
+/* How many tiles across and up a TileCache holds at most. */
+#define TILE_CACHE_SIZE 8
+
+/* Which tiles in a small piece of the map are solid, which are platforms,
+and which hurt things that overlap them, a bit for each. Moving one thing
+looks at the same few tiles over and over, so they're read from the map once
+and looked up here after that.
+Bit j * TILE_CACHE_SIZE + i is the tile at left + i, bottom + j. left isn't
+wrapped, so it uses the same x as the rect being moved, and tiles outside
+width and height get looked up on the map as usual. */
+struct TileCache {
+    int left;
+    int bottom;
+    int width;
+    int height;
+    uint64_t solid;
+    uint64_t platform;
+    uint64_t hurts;
 };
 
 /* A class to handle collisions. It takes a map and a vector of movables
@@ -96,47 +115,132 @@ class Collider {
     int xOffset;
     int yOffset;
 
-    // Given that a collision happens left or right, update info accordingly.
-    // dx is the step size and w is the width of the player.
-    void findXCollision(CollisionInfo &info, int dx, int w, const Rect &stays)
-        const;
+    /* Whether each type of tile is solid, a platform, or hurts, so filling
+    the cache doesn't need to look at the tiles themselves. */
+    std::vector<uint8_t> tileFlags;
+
+    /* The tiles around whatever is being moved right now. */
+    TileCache cache;
+
+    /* Where the dropped items are this tick, so things only look at the
+    items near them. */
+    SpatialHash itemHash;
+
+    /* For the results of looking things up in itemHash, so a new vector
+    isn't needed each time. */
+    std::vector<int> nearby;
+
+    /* Where the entities are this tick, for finding which ones touch each
+    other and which ones are inside hitboxes. */
+    SpatialHash entityHash;
+
+    /* Pairs of entities that overlap, by index. */
+    std::vector<std::pair<int, int>> touching;
 
-    // Given that a collision is up or down, update info accordingly
-    // dy is the step size and h is the height of the player.
-    void findYCollision(CollisionInfo &info, int dy, int h, const Rect &stays)
-        const;
+    /* This tick's hitboxes, and for each thing one hits, the hitbox and the
+    entity by index. */
+    std::vector<Hitbox> hitboxes;
+    std::vector<std::pair<int, int>> hits;
+
+    /* The dropped items' physics, and which items ran into a wall and need
+    to be moved the slow way. */
+    ItemBodies bodies;
+    std::vector<int> blocked;
+
+    /* Return the TILE_FLAG bits of the tile at x, y, from the cache if it's
+    there. This only works during update. */
+    uint8_t getFlags(Map &map, int x, int y) const;
+
+    /* Return whether the tile at x, y stops things. Platforms only stop
+    things falling onto them, and only when they aren't dropping down.
+    Tiles above or below the map don't stop anything. */
+    bool blocks(Map &map, int x, int y, bool platforms) const;
+
+    /* Fill the cache with every tile moving the rect by dx, dy could run
+    into. If that's too many tiles, leave the cache empty. */
+    void fillCache(Map &map, const Rect &rect, int dx, int dy);
+
+    /* Return whether anything in column x stops a rect of height h at y. */
+    bool columnBlocks(Map &map, int x, double y, int h) const;
+
+    /* Return whether anything in row y stops a rect of width w at x. */
+    bool rowBlocks(Map &map, int y, double x, int w, bool platforms) const;
+
+    /* For a rect that starts at start, is size long and moves by distance
+    along one axis, find the next row or column of tiles it will run into
+    and set index to it. Return how far along the move it gets there, from 0
+    to 1, or more than 1 if it doesn't get there at all. */
+    double nextTile(int start, int size, int distance, int tileSize,
+        int offset, int &index) const;
+
+    /* Move a rect in a straight line, walking through the tiles it passes
+    in order, and stop at the first one it runs into. The cost depends on
+    how many tiles it passes and not on how fast it's going. */
+    SweepResult sweep(Map &map, const Rect &rect, int dx, int dy,
+        bool dropDown) const;
 
     /* Returns true if the rect is colliding with any solid (not platform) map
     tile. */
     bool collidesTiles(const Rect &rect, Map &map) const;
 
-    // Returns info on the collision between a moving thing and a stationary 
-    // thing. Collisions that occur even if the moving thing stays still will
-    // be ignored. 
-    CollisionInfo findCollision(const Rect &from, const Rect &to, 
-        const Rect &stays) const;
-
-    /* Goes through the tiles near the movable, finds all collisions, and adds
-    them to the vactor collisions. If any of the collisions are inevitable, it 
-    returns true. Otherwise, it returns false. If dropDown is true, it will 
-    not count collisions with platforms. */
-    bool listCollisions(std::vector<CollisionInfo> &collisions, Map &map, 
-        const Rect &to, const Rect &from, bool dropDown) const;
-
     // Takes a movable and a map, and moves it to where it should end up
     void collide(Map &map, movable::Movable &movable);
 
+    /* Move a movable whose velocity has already been updated, stepping up
+    onto tiles if it can. */
+    void moveMovable(Map &map, movable::Movable *movable);
+
+    /* Return the gravity and drag where the middle of the rect is. This
+    looks at one chunk's field and one tile however big the rect is, so
+    it's done once per thing per tick instead of in collide. */
+    PhysicsSample getPhysics(Map &map, const Rect &rect) const;
+
     /* Does everything needed to update a movable. */
     void updateMovable(Map &map, movable::Movable *movable);
 
+    /* Find every pair of entities that overlap and every entity inside a
+    hitbox, and have them hurt and push each other. */
+    void collideEntities(Map &map, SlotMap<Entity> &entities);
+
+    /* Update the velocity of every dropped item and move them. Items that
+    don't run into a wall never need anything but their numbers in bodies,
+    and the rest are moved one at a time like any other movable. */
+    void updateItems(Map &map, SlotMap<DroppedItem> &droppedItems);
+
 public:
     // Constructor
     Collider(int tileWidth, int tileHeight);
 
     // A function that takes a map and a list of things and moves them, 
     // colliding when necessary
-    void update(Map &map, std::vector<Entity *> &entities, 
-        std::vector<DroppedItem *> droppedItems);
+    void update(Map &map, SlotMap<Entity> &entities, 
+        SlotMap<DroppedItem> &droppedItems);
+
+    /* Questions about where things could go. These take plain rects, with x
+    anywhere on or off the map, and never copy or change a movable, so they're
+    cheap enough to ask as often as needed. */
+
+    /* Return whether the rect overlaps a solid tile, counting tiles as smaller
+    by the offsets, the same way moving things do. */
+    bool overlapsSolid(Map &map, const Rect &rect) const;
+
+    /* Move a rect by dx, dy, stopping at tiles and the top and bottom of the
+    map. When it hits something it stops going that way and keeps going the
+    other way. Tiles it starts off overlapping don't stop it. */
+    MoveResult move(Map &map, Rect from, int dx, int dy, bool dropDown) const;
+
+    /* Follow a line from x, y to x + dx, y + dy and find the first solid tile
+    it goes into. Platforms and the tile it starts in don't stop it. */
+    SweepResult raycast(Map &map, int x, int y, int dx, int dy) const;
+
+    /* Return whether the rect overlaps any of the entities. */
+    bool overlapsEntity(const Rect &rect,
+        const SlotMap<Entity> &entities) const;
+
+    /* Return whether a solid tile at x, y would overlap any of the
+    entities. */
+    bool tileOverlapsEntity(Map &map, int x, int y,
+        const SlotMap<Entity> &entities) const;
 };
 
 #endif
@@ -140,6 +140,8 @@ EventHandler::EventHandler() {
     keySettings.inventoryKeys.push_back(SDL_SCANCODE_C);
     /* Keys to toss items. */
     keySettings.tossKeys.push_back(SDL_SCANCODE_T);
+    /* Keys to show the tile update profile. */
+    keySettings.profileKeys.push_back(SDL_SCANCODE_F3);
     // And each of 24 keys to select a hotbar slot
     keySettings.hotbarKeys.push_back(SDL_SCANCODE_1);
     keySettings.hotbarKeys.push_back(SDL_SCANCODE_2);
@@ -276,7 +278,7 @@ void EventHandler::useMouse(Player &player, World &world) {
 
 // Do whatever should be done when key presses or releases happen
 void EventHandler::keyEvent(const SDL_Event &event, Player &player, 
-        vector<DroppedItem *> &drops) { 
+        SlotMap<DroppedItem> &drops) { 
     SDL_Scancode key = event.key.keysym.scancode;
 
     // Here we should handle keys which don't need to be held down to work.
@@ -289,6 +291,9 @@ void EventHandler::keyEvent(const SDL_Event &event, Player &player,
     else if (isIn(key, keySettings.tossKeys)) {
         player.toss(drops);
     }
+    else if (isIn(key, keySettings.profileKeys)) {
+        player.isProfileShown = !player.isProfileShown;
+    }
     else if (isIn(key, keySettings.hotbarKeys)) {
         // Select the appropriate slot in the hotbar
         // This vector actually has the order matter, so you can't map more
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <SDL2/SDL.h>
+#include "util/SlotMap.hh"
 
 // forward declare
 class WindowHandler;
@@ -29,6 +30,9 @@ struct KeySettings {
 
     /* Keys to toss items onto the ground. */
     std::vector<SDL_Scancode> tossKeys;
+
+    /* Keys to show or hide the tile update profile. */
+    std::vector<SDL_Scancode> profileKeys;
 };
 
 /* A class to handle events such as keyboard input or mouse movement. */
@@ -96,7 +100,7 @@ public:
 
     // Do whatever should be done when a key is pressed or released
     void keyEvent(const SDL_Event &event, Player &player, 
-        std::vector<DroppedItem *> &drops);
+        SlotMap<DroppedItem> &drops);
 
     // Do stuff for keys being held down
     void updateKeys(const Uint8 *state);
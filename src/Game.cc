@@ -1,6 +1,7 @@
 #include "Game.hh"
 
 #include <iostream>
+#include <algorithm>
 #include <cassert>
 #include "world/Tile.hh"
 #include "world/Mapgen.hh"
@@ -22,40 +23,55 @@ bool Game::play(string mapname) {
 
     window.setMapSize(world -> map.getWidth(), world -> map.getHeight());
 
-    /* Frames since the start of the world. */
+    /* Ticks since the start of the world. */
     uint32_t gameTicks = 0;
 
+    /* The world always goes forward in ticks of the same length, however
+    often the screen gets drawn, so it runs at the same speed on every
+    computer. Time that's passed but hasn't been simulated yet piles up here,
+    and each tick uses up a tick's worth. */
+    uint64_t frequency = SDL_GetPerformanceFrequency();
+    uint64_t tickLength = frequency / SCREEN_FPS;
+    uint64_t unsimulated = 0;
+    uint64_t lastTime = SDL_GetPerformanceCounter();
+
     /* Loop infinitely until exiting. */
     bool quit = false;
     while (!quit) {
-        Uint32 ticks = SDL_GetTicks();
+        uint64_t frameStart = SDL_GetPerformanceCounter();
+        unsimulated += frameStart - lastTime;
+        lastTime = frameStart;
+        unsimulated = min(unsimulated, MAX_CATCH_UP_TICKS * tickLength);
+
         /* Handle events on the queue. */
         quit = update();
 
-        /* Now that all the events have been handled, do eventhandling things 
-        that need to be done every update (like checking whether any keys
-        or mouse buttons are being held down). */
-        eventHandler.update(*world);
+        while (unsimulated >= tickLength) {
+            /* Now that all the events have been handled, do eventhandling
+            things that need to be done every update (like checking whether
+            any keys or mouse buttons are being held down). */
+            eventHandler.update(*world);
 
-        world -> update();
+            world -> update();
+            unsimulated -= tickLength;
 
-        /* Put pictures on the screen, but only if rendering isn't really 
-        slow. */
-        uint32_t frameTicks = SDL_GetTicks() - ticks;
-        if (frameTicks < 2 * TICKS_PER_FRAME) { 
-            window.update(*world);
+            /* Count the number of ticks. */
+            gameTicks++;
         }
 
-        /* Count the number of times we've gone through this loop. */
-        gameTicks++;
+        /* Put pictures on the screen, with everything drawn however far it
+        is between the last tick and the next. */
+        window.update(*world, (double)unsimulated / tickLength);
 
-        /* Wait for enough time to pass before doing the next frame. */
-        frameTicks = SDL_GetTicks() - ticks;
-        if (frameTicks < TICKS_PER_FRAME) {
-            SDL_Delay(TICKS_PER_FRAME - frameTicks);
+        /* Wait a bit if the frame went by faster than anyone could see. */
+        uint64_t frameTime = SDL_GetPerformanceCounter() - frameStart;
+        uint64_t minFrameTime = frequency / MAX_FRAME_RATE;
+        if (frameTime < minFrameTime) {
+            SDL_Delay((minFrameTime - frameTime) * 1000 / frequency);
         }
     }
     world -> map.save(PATH_TO_EXECUTABLE + mapname);
+    world -> map.saveProfile(PATH_TO_EXECUTABLE + mapname + "_profile.csv");
 
     isPlaying = false;
     delete world;
@@ -8,8 +8,17 @@
 
 class Menu;
 
+/* The most ticks to run in one go to catch up after a slow frame. If the
+computer can't keep up even so, the world slows down rather than the game
+spending all its time catching up and never drawing anything. */
+#define MAX_CATCH_UP_TICKS 5
+
+/* Don't draw more often than this, even if nothing is waiting for vsync. */
+#define MAX_FRAME_RATE 240
+
 class Game { 
-    /* For capping the frame rate. */
+    /* How often the world updates, and for capping the frame rate at the
+    menu. */
     const uint32_t SCREEN_FPS;
     const uint32_t TICKS_PER_FRAME;
 
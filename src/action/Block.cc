@@ -87,7 +87,7 @@ bool Block::use_internal(InputType type, int x, int y, World &world) {
 
     /* If success is still false at the end, don't set the player's use
     time left. */
-    bool success = world.map.placeTile(
+    bool success = world.placeTile(
             world.map.getMapCoords(x, y, layer), tileType);
 
     return success;
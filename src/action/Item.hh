@@ -40,6 +40,10 @@ public:
         stack = s;
     }
 
+    inline int getMaxStack() {
+        return maxStack;
+    }
+
     inline int isConsumable() {
         return consumable;
     }
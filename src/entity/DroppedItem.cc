@@ -1,7 +1,21 @@
 #include "DroppedItem.hh"
+#include "../util/Pool.hh"
 
 using namespace std;
 
+static Pool<sizeof(DroppedItem)> pool;
+
+void *DroppedItem::operator new(size_t size) {
+    assert(size == sizeof(DroppedItem));
+    return pool.allocate();
+}
+
+void DroppedItem::operator delete(void *pointer) {
+    if (pointer != nullptr) {
+        pool.release(pointer);
+    }
+}
+
 DroppedItem::DroppedItem(Item *i, int x, int y, int worldWidth) {
     item = i;
     setX(x);
@@ -9,12 +23,12 @@ DroppedItem::DroppedItem(Item *i, int x, int y, int worldWidth) {
     rect.w = i->sprite.getWidth();
     rect.h = i->sprite.getHeight();
     rect.worldWidth = worldWidth;
+    savePosition();
     nextRect = rect;
     nextRect.x = 0;
     nextRect.y = 0;
 
-    // TODO: remove magic numbers
-    drag = {0.95, 0.9166};
+    drag = {ITEM_DRAG_X, ITEM_DRAG_Y};
     attracting = false;
     throwticks = 0;
 }
@@ -23,14 +37,15 @@ DroppedItem::~DroppedItem() {
     delete item;
 }
 
-void DroppedItem::render(const Rect &camera) {
+void DroppedItem::render(const Rect &camera, double alpha) {
     if (!item) {
         return;
     }
     // Make sure the renderer draw color is set to white
     Renderer::setColorWhite();
 
-    SDL_Rect to = {rect.x, rect.y, rect.w, rect.h};
+    Rect renderRect = getRenderRect(alpha);
+    SDL_Rect to = {renderRect.x, renderRect.y, rect.w, rect.h};
     convertRect(to, camera);
     item -> sprite.render(to);
 }
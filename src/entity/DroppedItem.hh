@@ -8,6 +8,11 @@
 #define ITEM_ATTRACT_SPEED 8.0
 #define ITEM_THROW_SPEED 8.0
 
+/* Every dropped item has the same drag, so the collider can move them all
+together. */
+#define ITEM_DRAG_X 0.95
+#define ITEM_DRAG_Y 0.9166
+
 class DroppedItem: public movable::Movable {
     bool attracting;
     int throwticks;
@@ -27,22 +32,28 @@ public:
     DroppedItem(Item *item, int x, int y, int worldWidth);
     ~DroppedItem();
 
+    /* Dropped items come and go a lot, so they're kept in a pool instead of
+    each getting their own trip to the heap. */
+    static void *operator new(size_t size);
+    static void operator delete(void *pointer);
+
     /* Render itself. */
-    virtual void render(const Rect &camera);
+    virtual void render(const Rect &camera, double alpha);
 
     /* Merge with another stack. */
     void merge(DroppedItem *item);
 
-    /* Be thrown. dir = 0 for left or 1 for right. */
-    inline void toss(bool dir, int dist) {
+    /* Be thrown. dir = 0 for left or 1 for right. The speed is a little
+    random, using whoever threw it's random numbers. */
+    inline void toss(bool dir, int dist, RandomStream &thrower) {
         int d = 2 * dir - 1;
         // TODO: if I want this to throw at just the right speed, I'll need
         // to do a calculation involving drag.
         throwticks = 2 * dist / ITEM_THROW_SPEED;
         velocity.x = d * ITEM_THROW_SPEED 
-            + (rand() % (int)(ITEM_THROW_SPEED * 16))/ 32.0;
+            + thrower.below((int)(ITEM_THROW_SPEED * 16)) / 32.0;
         velocity.y = ITEM_THROW_SPEED 
-            + (rand() % (int)(ITEM_THROW_SPEED * 16)) / 32.0;
+            + thrower.below((int)(ITEM_THROW_SPEED * 16)) / 32.0;
     }
 
     /* Move in a direction. */
@@ -21,6 +21,11 @@ Entity::Entity(std::string filename)
     invincibilityLeft = 0;
     isFacingRight = true;
     hasInventory = false; // A child class with an inventory should set this
+    hasContactDamage = j.find("contactDamage") != j.end();
+    if (hasContactDamage) {
+        contactDamage = j["contactDamage"].get<Damage>();
+    }
+    contactKnockback = j.value("contactKnockback", 0.0);
     sprites = j["sprites"].get<std::vector<Sprite>>();
     /* The rect starts as size of the correct sprite. */
     rect = sprites[isFacingRight].getRect();
@@ -33,7 +38,7 @@ Entity::Entity(std::string filename)
     run.emplace_back(j["run_right"], sprite_path);
 }
 
-Entity::Entity() {};
+Entity::Entity() : hasContactDamage(false), contactKnockback(0) {};
 
 // Virtual destructor
 Entity::~Entity() {}
@@ -54,14 +59,15 @@ void Entity::takeDamage(const Damage &damage) {
 
     double baseDamage = damage.getBaseDamage();
     assert(baseDamage >= 1);
-    if ((double)(rand() % 100) < 100.0 * damage.criticalChance) {
+    if (random.fraction() < damage.criticalChance) {
         baseDamage *= damage.criticalAmount;
     }
 
     // TODO: use defense
     health.addFull(-1 * (int)baseDamage);
     if (damage.maxWounds > 0) {
-        double woundRate = (double)(rand() % (int)(damage.maxWounds * 100));
+        double woundRate
+            = (double)random.below((int)(damage.maxWounds * 100));
         woundRate /= 100.0;
         woundRate += damage.minWounds;
         health.addPart(-1 * (int)(baseDamage * woundRate));
@@ -91,7 +97,7 @@ void Entity::takeFallDamage() {
 }
 
 /* Do the things! */
-void Entity::update(vector<DroppedItem*> &drops) {
+void Entity::update(SlotMap<DroppedItem> &drops) {
     health.update();
     fullness.update();
     mana.update();
@@ -105,13 +111,14 @@ void Entity::update(vector<DroppedItem*> &drops) {
     }
 }
 
-void Entity::render(const Rect &camera) {
+void Entity::render(const Rect &camera, double alpha) {
     // Make sure the renderer draw color is set to white
     Renderer::setColorWhite();
 
+    Rect renderRect = getRenderRect(alpha);
     SDL_Rect rectTo;
-    rectTo.x = rect.x;
-    rectTo.y = rect.y;
+    rectTo.x = renderRect.x;
+    rectTo.y = renderRect.y;
 
     /* Which sprite to draw. */
     SpriteBase *drawSprite = nullptr;
@@ -143,6 +150,10 @@ void Entity::render(const Rect &camera) {
 
 void Entity::pickup(DroppedItem *item) {}
 
+int Entity::getPickupDistance() const {
+    return 0;
+}
+
 /* Make an entity from a json. */
 void from_json(const json &j, Entity &entity) {
     entity.maxFallDistance = j["maxFallDistance"];
@@ -150,3 +161,36 @@ void from_json(const json &j, Entity &entity) {
     entity.fullness = j["fullness"].get<Stat>();
     entity.mana = j["mana"].get<Stat>();
 }
+
+void Entity::touch(Entity &other) {
+    if (hasContactDamage) {
+        Hitbox hitbox;
+        hitbox.rect = rect;
+        hitbox.damage = contactDamage;
+        hitbox.knockback = contactKnockback;
+        hitbox.owner = this;
+        other.hit(hitbox);
+    }
+}
+
+void Entity::hit(const Hitbox &hitbox) {
+    /* While it can't be hurt, it can't be pushed around either. */
+    if (invincibilityLeft >= 0) {
+        return;
+    }
+
+    /* Get knocked away from the middle of the hitbox, the short way round
+    the world. */
+    int dx = getCenterX() - (hitbox.rect.x + hitbox.rect.w / 2);
+    if (rect.worldWidth > 0) {
+        dx = (dx % rect.worldWidth + rect.worldWidth) % rect.worldWidth;
+        if (dx > rect.worldWidth / 2) {
+            dx -= rect.worldWidth;
+        }
+    }
+    int direction = dx >= 0? 1 : -1;
+    velocity.x = direction * hitbox.knockback;
+    velocity.y = std::max(velocity.y, hitbox.knockback / 2);
+
+    takeDamage(hitbox.damage);
+}
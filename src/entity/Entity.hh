@@ -2,9 +2,11 @@
 #define ENTITY_HH
 
 #include "Movable.hh"
+#include "Hitbox.hh"
 #include "../Stat.hh"
 #include "../Damage.hh"
 #include "../render/Animation.hh"
+#include "../util/SlotMap.hh"
 
 #include <nlohmann/json.hpp>
 #include <string>
@@ -38,6 +40,16 @@ public:
     /* Whether or not it can pick up items. */
     bool hasInventory;
 
+    /* Damage done to anything that touches it, and how hard that knocks
+    them away. */
+    bool hasContactDamage;
+    Damage contactDamage;
+    double contactKnockback;
+
+    /* Attacks it's making this tick. The collider hits everything inside
+    them, then clears them. */
+    std::vector<Hitbox> hitboxes;
+
     /* Sitting sprites. */
     std::vector<Sprite> sprites;
     std::vector<Animation> run;
@@ -60,13 +72,22 @@ public:
     virtual void takeFallDamage();
 
     /* Do the things! */
-    virtual void update(std::vector<DroppedItem*> &drops);
+    virtual void update(SlotMap<DroppedItem> &drops);
 
     /* Render the correct sprite / animation. */
-    virtual void render(const Rect &camera);
+    virtual void render(const Rect &camera, double alpha);
 
     /* Attempt to pick up an item. */
     virtual void pickup(DroppedItem *item);
+
+    /* How far away items have to be for it to not try to pick them up. */
+    virtual int getPickupDistance() const;
+
+    /* Another entity is overlapping it. */
+    virtual void touch(Entity &other);
+
+    /* Take a hitbox's damage and get knocked away from it. */
+    virtual void hit(const Hitbox &hitbox);
 };
 
 void from_json(const nlohmann::json &j, Entity &entity);
@@ -0,0 +1,22 @@
+#ifndef HITBOX_HH
+#define HITBOX_HH
+
+#include "../Rect.hh"
+#include "../Damage.hh"
+
+class Entity;
+
+/* Somewhere that hurts any entity overlapping it this tick, like a swung
+sword or a bite. */
+struct Hitbox {
+    Rect rect;
+    Damage damage;
+
+    /* How fast it sends things it hits flying away from its center. */
+    double knockback;
+
+    /* Whoever made it, so it doesn't hit them. */
+    const Entity *owner;
+};
+
+#endif
@@ -18,6 +18,8 @@ void from_json(const json &j, Point &point) {
     point.y = j["y"];
 }
 
+unsigned int Movable::nextId = 0;
+
 // Constructor
 Movable::Movable() {
     velocity.x = 0;
@@ -36,6 +38,8 @@ Movable::Movable() {
 
     pixelsFallen = 0;
     maxHeight = 0;
+    lastX = 0;
+    lastY = 0;
 
     // These should be changed by the child class's init.
     drag.x = 0;
@@ -70,6 +74,8 @@ Movable &Movable::operator=(const Movable &movable) {
     }
     rect = movable.rect;
     nextRect = movable.nextRect;
+    lastX = movable.lastX;
+    lastY = movable.lastY;
     drag = movable.drag;
     velocity = movable.velocity;
     accel = movable.accel;
@@ -113,7 +119,7 @@ Point Movable::getDAccel() const {
 
 // This adds acceleration to speed, and limits speed at maxSpeed. This also
 // updates the value of timeOffGround and maxHeight.
-void Movable::updateMotion(double gravitynum) {
+void Movable::updateMotion(const PhysicsSample &physics) {
     // Make sure the movable has been properly initialized
     assert(drag.x || drag.y);
 
@@ -136,19 +142,21 @@ void Movable::updateMotion(double gravitynum) {
     // Update velocity
     velocity.x += accel.x;
     velocity.y += accel.y;
-    if (!isSteppingUp && gravity) {
-        velocity.y += gravitynum;
+    bool falls = !isSteppingUp && gravity;
+    if (falls) {
+        velocity.y += physics.gravity;
     }
 
     // Add drag effects
-    velocity.x *= drag.x;
-    velocity.y *= drag.y;
+    velocity.x *= drag.x * physics.dragX;
+    velocity.y *= drag.y * physics.dragY;
 
-    // Don't bother going ridiculously slowly
+    // Don't bother going ridiculously slowly. Falling things are left alone,
+    // or gravity weaker than this would never get them moving.
     if (-1 < velocity.x && velocity.x < 1) {
         velocity.x = 0;
     }
-    if (-1 < velocity.y && velocity.y < 1) {
+    if (-1 < velocity.y && velocity.y < 1 && !falls) {
         velocity.y = 0;
     }
     
@@ -176,7 +184,7 @@ void Movable::convertRect(SDL_Rect &rect, const Rect &camera) {
     rect.y = camera.y + camera.h - rect.y - rect.h;
 }
 
-void Movable::render(const Rect &camera) {}
+void Movable::render(const Rect &camera, double alpha) {}
 
 int Movable::getWidth() const {
     return rect.w;
@@ -194,6 +202,27 @@ Rect Movable::getNextRect() const {
     return nextRect;
 }
 
+Rect Movable::getRenderRect(double alpha) const {
+    Rect renderRect = rect;
+    int dx = rect.x - lastX;
+    /* If it went over the edge of the world, it went the short way round. */
+    if (rect.worldWidth > 0) {
+        if (dx > rect.worldWidth / 2) {
+            dx -= rect.worldWidth;
+        }
+        else if (dx < -rect.worldWidth / 2) {
+            dx += rect.worldWidth;
+        }
+    }
+    renderRect.x = lastX + (int)round(dx * alpha);
+    renderRect.y = lastY + (int)round((rect.y - lastY) * alpha);
+    if (rect.worldWidth > 0) {
+        renderRect.x = (renderRect.x % rect.worldWidth + rect.worldWidth)
+            % rect.worldWidth;
+    }
+    return renderRect;
+}
+
 void Movable::advanceRect() {
     rect.x += nextRect.x;
     rect.y += nextRect.y;
@@ -259,6 +288,7 @@ void from_json(const json &j, Movable &movable) {
     movable.minVelocity = j["minVelocity"];
     movable.rect.x = j["x"];
     movable.rect.y = j["y"];
+    movable.savePosition();
 }
 
 } // End namespace movable
@@ -4,6 +4,8 @@
 #include "../Damage.hh"
 #include "../render/Sprite.hh"
 #include "../Rect.hh"
+#include "../util/Random.hh"
+#include "../world/PhysicsField.hh"
 
 #include <nlohmann/json.hpp>
 #include <algorithm>
@@ -31,8 +33,28 @@ protected:
     /* For attempting to change collision rect size. */
     Rect nextRect;
 
+    /* The next id to hand out, so every movable gets a different one. */
+    static unsigned int nextId;
+    unsigned int id = nextId++;
+
+    /* Random numbers for this tick. The world gives each movable a new
+    stream every tick, keyed by its id, so it doesn't matter what order
+    movables update in. */
+    RandomStream random;
+
+    /* Where it was at the start of this tick, for drawing it partway between
+    there and where it is now. */
+    int lastX;
+    int lastY;
+
 public:
     /* Access functions. */
+    inline unsigned int getId() const {
+        return id;
+    }
+    inline void setRandom(const RandomStream &newRandom) {
+        random = newRandom;
+    }
     inline void setX(int x) {
         rect.x = x;
     }
@@ -40,6 +62,14 @@ public:
         rect.y = y;
     }
 
+    /* Remember where it is now as where it was at the start of the tick. This
+    should also be called after putting it somewhere new, so it doesn't look
+    like it slid there. */
+    inline void savePosition() {
+        lastX = rect.x;
+        lastY = rect.y;
+    }
+
     /* Allow from_json access to private variables, since it is basically a
     factory function. */
     friend void from_json(const nlohmann::json &j, Movable &movable);
@@ -118,8 +148,8 @@ public:
         return r;
     }
 
-    // Updates velocity
-    void updateMotion(double gravity);
+    // Updates velocity, with the gravity and extra drag of wherever it is
+    void updateMotion(const PhysicsSample &physics);
 
     /* Take damage. Since movables in general don't have health, this mostly
     exists so the collider can tell movables to take damage from overlapping a
@@ -133,15 +163,19 @@ public:
     static void convertRect(SDL_Rect &rect, const Rect &camera);
 
     /* Render itself to the screen, given a Rect that tells it where the
-    screen is in the world. Since Movables don't have sprites, this is just
-    here to be virtual. */
-    virtual void render(const Rect &camera);
+    screen is in the world, and how far it is from the last tick to the next,
+    between 0 and 1. Since Movables don't have sprites, this is just here to be
+    virtual. */
+    virtual void render(const Rect &camera, double alpha);
 
     /* Get height and width, defined by height and width of the sprite. */
     virtual int getWidth() const;
     virtual int getHeight() const;
     Rect getRect() const;
     Rect getNextRect() const;
+    /* The rect to draw, alpha of the way from where it was at the start of
+    the tick to where it is now. */
+    Rect getRenderRect(double alpha) const;
     /* Allow change of collision rect. */
     void advanceRect();
     /* Set nextRect = rect, cancel collision rect change. */
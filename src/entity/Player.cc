@@ -107,6 +107,7 @@ Player::Player() : Entity(PATH_TO_EXECUTABLE + "entities/bunny.json"),
     pickup(ItemMaker::makeItem(ActionType::TORCH));
 
     isInventoryOpen = false;
+    isProfileShown = false;
 }
 
 // Switch whether the inventory is open or closed
@@ -167,7 +168,7 @@ void Player::useAction(InputType type, int x, int y, World &world) {
     }
 }
 
-void Player::update(vector<DroppedItem*> &drops) {
+void Player::update(SlotMap<DroppedItem> &drops) {
     Entity::update(drops);
     // Tick down the time until we can use items again
     assert(useTimeLeft >= 0);
@@ -232,11 +233,15 @@ void Player::pickup(DroppedItem *item) {
     attractOther(PLAYER_PICKUP_DISTANCE, ITEM_ATTRACT_SPEED, item);
 }
 
+int Player::getPickupDistance() const {
+    return PLAYER_PICKUP_DISTANCE;
+}
+
 DroppedItem *Player::drop() {
     if (mouseSlot && mouseSlot -> isItem()) {
         DroppedItem *dropped = new DroppedItem((Item *)mouseSlot, 
             getCenterX(), getCenterY(), rect.worldWidth);
-        dropped -> toss(isFacingRight, PLAYER_PICKUP_DISTANCE);
+        dropped -> toss(isFacingRight, PLAYER_PICKUP_DISTANCE, random);
         mouseSlot = nullptr;
         return dropped;
     }
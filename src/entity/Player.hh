@@ -40,6 +40,9 @@ public:
     int screenX, screenY;
 
     bool isInventoryOpen;
+
+    /* Whether to show what each type of tile costs to update. */
+    bool isProfileShown;
     Inventory inventory;
     Inventory trash;
 
@@ -69,7 +72,7 @@ public:
     void useAction(InputType type, int x, int y, World &world);
 
     /* Update self, including statbars (so changes to stats actually render). */
-    void update(std::vector<DroppedItem*> &drops);
+    void update(SlotMap<DroppedItem> &drops);
 
     /* Place an item in the inventory or the hotbar. Return the item if it 
     doesn't fit. */
@@ -78,12 +81,14 @@ public:
     // Try to pick up an item
     virtual void pickup(DroppedItem *item);
 
-    /* Drop the items the mouse is holding to the ground and add it to the 
-    vector. */
-    inline void toss(std::vector<DroppedItem *> &drops) {
+    virtual int getPickupDistance() const;
+
+    /* Drop the items the mouse is holding to the ground and add it to the
+    dropped items. */
+    inline void toss(SlotMap<DroppedItem> &drops) {
         DroppedItem *d = drop();
         if (d) {
-            drops.push_back(d);
+            drops.insert(d);
         }
     }
 };
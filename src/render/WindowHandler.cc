@@ -1,6 +1,8 @@
 #include <cassert>
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <cstdio>
 #include <SDL2/SDL_image.h>
 #include <SDL2/SDL_ttf.h>
 #include "WindowHandler.hh"
@@ -15,6 +17,11 @@
 #include "../Rect.hh"
 #include "../world/World.hh"
 
+/* How the tile update profile looks. */
+#define PROFILE_FONT_SIZE 13
+#define PROFILE_MARGIN 4
+#define PROFILE_LINES 12
+
 using namespace std;
 
 // Return a rectangle in world coordinates for a player at x, y
@@ -93,6 +100,7 @@ WindowHandler::WindowHandler(int screenWidth, int screenHeight,
         TILE_WIDTH(tileWidth), TILE_HEIGHT(tileHeight) {
     window = NULL;
     screenSurface = NULL;
+    profileTicks = 0;
 
     // Set the 2D vector of rects for the tiles
     resize(screenWidth, screenHeight);
@@ -149,8 +157,10 @@ void WindowHandler::init() {
         else {
             // Create a renderer for the window
             Renderer::m.lock();
+            // Wait for vsync when showing a frame, so there's a frame for
+            // each time the screen refreshes, however fast that is
             Renderer::renderer = SDL_CreateRenderer(window, -1, 
-                                            SDL_RENDERER_ACCELERATED);
+                    SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
 
             // Fall back to a software renderer if necessary
             if (Renderer::renderer == NULL) {
@@ -243,26 +253,35 @@ void WindowHandler::renderMap(Map &m, const Rect &camera) {
             Light light = m.getLight(xTile, yTile);
             light.a = 255;
             Location place(xTile, yTile, MapLayer::BACKGROUND);
-            uint8_t background = m.getBackgroundVariant(xTile, yTile);
-            uint8_t foreground = m.getForegroundVariant(xTile, yTile);
+            /* Animated tiles pick their frame from the tick. */
+            uint8_t background = m.getBackground(xTile, yTile) -> getFrame(
+                m.getBackgroundVariant(xTile, yTile), m.getTick());
+            uint8_t foreground = m.getForeground(xTile, yTile) -> getFrame(
+                m.getForegroundVariant(xTile, yTile), m.getTick());
             m.getBackground(xTile, yTile) -> render(background, m.bordering(place), light, rectTo);
             place.layer = MapLayer::FOREGROUND;
-            m.getForeground(xTile, yTile) -> render(foreground, m.bordering(place), light, rectTo);
+            /* Water that isn't full only fills the bottom of its tile. */
+            SDL_Rect foreTo = rectTo;
+            uint8_t liquid = m.getLiquid(xTile, yTile);
+            if (liquid != 0 && liquid < LIQUID_FULL) {
+                foreTo.h = max(1, TILE_HEIGHT * liquid / LIQUID_FULL);
+                foreTo.y += TILE_HEIGHT - foreTo.h;
+            }
+            m.getForeground(xTile, yTile) -> render(foreground, m.bordering(place), light, foreTo);
         }
     }
 }
 
 // Update the screen
-void WindowHandler::update(World &world) {
+void WindowHandler::update(World &world, double alpha) {
     /* Find the camera. */
     int w = world.player.getWidth();
     int h = world.player.getHeight();
-    Rect camera = findCamera(world.player.getRect().x, 
-        world.player.getRect().y, w, h);
+    Rect playerDrawn = world.player.getRenderRect(alpha);
+    Rect camera = findCamera(playerDrawn.x, playerDrawn.y, w, h);
     /* Tell the player where on the screen they are. This is only used by
     EventHandler. TODO: remove. */
-    SDL_Rect playerRect = { world.player.getRect().x, 
-        world.player.getRect().y, w, h };
+    SDL_Rect playerRect = { playerDrawn.x, playerDrawn.y, w, h };
     world.player.convertRect(playerRect, camera);
     world.player.screenX = playerRect.x;
     world.player.screenY = playerRect.y + playerRect.h;
@@ -286,22 +305,75 @@ void WindowHandler::update(World &world) {
 
         // Draw any movables
         for (unsigned int i = 0; i < world.entities.size(); i++) {
-            world.entities[i] -> render(camera);
+            world.entities[i] -> render(camera, alpha);
         }
         for (unsigned int i = 0; i < world.droppedItems.size(); i++) {
-            world.droppedItems[i] -> render(camera);
+            world.droppedItems[i] -> render(camera, alpha);
         }
 
         // Draw the UI
         renderUI(world.player);
+        if (world.player.isProfileShown) {
+            renderProfile(world.map);
+        }
 
         // Update the screen
         SDL_RenderPresent(Renderer::renderer);
     }
 }
 
+void WindowHandler::renderProfile(const Map &map) {
+    const TileProfile &profile = map.getProfile();
+    unsigned int ticks = profile.getTicks() - profile.getTicks()
+        % PROFILE_WINDOW;
+    if (profileLines.empty() || ticks != profileTicks) {
+        profileTicks = ticks;
+        profileLines.clear();
+
+        /* Most expensive first. */
+        vector<TileType> types;
+        for (int i = 0; i <= (int)TileType::LAST_TILE; i++) {
+            const TileCounters &recent = profile.getRecent((TileType)i);
+            if (recent.updates != 0 || recent.rejected != 0
+                    || recent.moves != 0) {
+                types.push_back((TileType)i);
+            }
+        }
+        sort(types.begin(), types.end(), [&](TileType a, TileType b) {
+            return profile.getRecent(a).nanoseconds
+                > profile.getRecent(b).nanoseconds;
+        });
+        types.resize(min((int)types.size(), PROFILE_LINES));
+
+        profileLines.emplace_back("Per tick: updates, rejected, moves, ms",
+            PROFILE_FONT_SIZE, 0);
+        char line[128];
+        for (unsigned int i = 0; i < types.size(); i++) {
+            const TileCounters &recent = profile.getRecent(types[i]);
+            snprintf(line, sizeof(line), "%s: %.1f, %.1f, %.1f, %.3f",
+                map.getTileName(types[i]).c_str(),
+                recent.updates / (double)PROFILE_WINDOW,
+                recent.rejected / (double)PROFILE_WINDOW,
+                recent.moves / (double)PROFILE_WINDOW,
+                recent.nanoseconds / 1000000.0 / PROFILE_WINDOW);
+            profileLines.emplace_back(line, PROFILE_FONT_SIZE, 0);
+        }
+    }
+
+    /* Down the right side of the screen. */
+    int y = PROFILE_MARGIN;
+    for (unsigned int i = 0; i < profileLines.size(); i++) {
+        profileLines[i].render(screenWidth - profileLines[i].getWidth()
+            - PROFILE_MARGIN, y);
+        y += profileLines[i].getHeight();
+    }
+}
+
 // Close the window, clean up, and exit SDL
 void WindowHandler::close() {
+    /* Textures have to go before the renderer does. */
+    profileLines.clear();
+
     /* Destroy window and renderer. */
     Renderer::m.lock();
     SDL_DestroyRenderer(Renderer::renderer);
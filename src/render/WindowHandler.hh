@@ -65,6 +65,15 @@ class WindowHandler {
     // Render everything UI
     void renderUI(Player &player);
 
+    /* A line of text for each of the tile types that cost the most recently,
+    and how many ticks the map had done when they were made. Making text is
+    slow, so this is only redone when the profile has new numbers. */
+    std::vector<Texture> profileLines;
+    unsigned int profileTicks;
+
+    /* Show what the tiles have been costing to update lately. */
+    void renderProfile(const Map &map);
+
     // Clean up and close SDL
     void close();
 
@@ -98,8 +107,9 @@ public:
     // where y = 0 is at the bottom
     void renderMap(Map &m, const Rect &camera);
 
-    // Update the screen
-    void update(World &world);
+    // Update the screen. alpha is how far it is from the last tick to the
+    // next, between 0 and 1, for drawing things partway between.
+    void update(World &world, double alpha);
 };
 
 #endif
@@ -11,7 +11,11 @@ using namespace std;
 
 void Menu::createWorld(string filename, WorldType type) {
     Mapgen mapgen;
-    mapgen.generate(PATH_TO_EXECUTABLE + filename, type, &create, &m);
+    /* Only make the world as it's explored, so it's ready to play right
+    away. */
+    mapgen.setStreamed(true);
+    mapgen.generate(PATH_TO_EXECUTABLE + filename, type, &create, 
+        &createProgress, &m);
 }
 
 vector<Buttonfun> Menu::getButtons(Screen s) {
@@ -69,6 +73,9 @@ std::vector<Spriterect> Menu::getSprites() {
             case CreateState::SETTLING_WATER:
                 message = "Settling water...";
                 break;
+            case CreateState::PLACING_STRUCTURES:
+                message = "Building ruins...";
+                break;
             case CreateState::GENERATING_OCEAN:
                 message = "Putting water in the ocean...";
                 break;
@@ -88,6 +95,11 @@ std::vector<Spriterect> Menu::getSprites() {
                 message = "Unsupported state.";
                 break;
         }
+        /* Steps that go a band of the map at a time know how far along
+        they are. */
+        if (createProgress != 0 && create != CreateState::DONE) {
+            message += " " + to_string(createProgress) + "%";
+        }
         m.unlock();
         sprites[1].sprite = Sprite(Texture(message, MENU_TEXT_SIZE, 0));
     }
@@ -135,6 +147,7 @@ Menu::Menu() {
     screenHeight = 0;
     setState(Screen::START);
     create = CreateState::NONE;
+    createProgress = 0;
     t = nullptr;
 }
 
@@ -161,6 +174,7 @@ void Menu::update(int width, int height) {
         m.lock();
         if (create == CreateState::NONE) {
             create = CreateState::NOT_STARTED;
+            createProgress = 0;
             assert(t == nullptr);
             t = new thread(&Menu::createWorld, this, getFilename(), 
                 WorldType::EARTH);
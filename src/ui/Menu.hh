@@ -67,8 +67,10 @@ class Menu {
     /* Position the sprites based on screen size. */
     void setSprites();
 
-    /* How far along world creation is. */
+    /* How far along world creation is, and how many percent of the way
+    through the current step. */
     CreateState create;
+    int createProgress;
 
     /* Thread for creating a world */
     std::thread *t;
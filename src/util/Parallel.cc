@@ -0,0 +1,87 @@
+#include "Parallel.hh"
+
+#include <cassert>
+
+using namespace std;
+
+WorkerPool::WorkerPool(int workerCount) : job(nullptr), context(nullptr),
+        count(0), slices(0), nextSlice(0), unfinished(0), generation(0),
+        quit(false), busy(false) {
+    for (int i = 0; i < workerCount; i++) {
+        workers.emplace_back(&WorkerPool::work, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    assert(!busy);
+    m.lock();
+    quit = true;
+    m.unlock();
+    wake.notify_all();
+    for (unsigned int i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+}
+
+void WorkerPool::runSlices(unique_lock<mutex> &lock) {
+    while (nextSlice < slices) {
+        int slice = nextSlice;
+        nextSlice++;
+        lock.unlock();
+        job(context, count * slice / slices, count * (slice + 1) / slices);
+        lock.lock();
+        unfinished--;
+        if (unfinished == 0) {
+            finished.notify_one();
+        }
+    }
+}
+
+void WorkerPool::work() {
+    unique_lock<mutex> lock(m);
+    unsigned int seen = generation;
+    while (true) {
+        wake.wait(lock, [&]() { return quit || generation != seen; });
+        if (quit) {
+            return;
+        }
+        /* If this worker was slow to wake up, the job might already be
+        done, in which case there won't be any slices left. */
+        seen = generation;
+        runSlices(lock);
+    }
+}
+
+bool WorkerPool::run(int count_in, int sliceCount, Job job_in,
+        void *context_in) {
+    assert(sliceCount > 0);
+    bool wasBusy = false;
+    if (!busy.compare_exchange_strong(wasBusy, true)) {
+        return false;
+    }
+
+    unique_lock<mutex> lock(m);
+    job = job_in;
+    context = context_in;
+    count = count_in;
+    slices = sliceCount;
+    nextSlice = 0;
+    unfinished = sliceCount;
+    generation++;
+    wake.notify_all();
+
+    /* Help out instead of just waiting. */
+    runSlices(lock);
+    finished.wait(lock, [this]() { return unfinished == 0; });
+    job = nullptr;
+    context = nullptr;
+    lock.unlock();
+
+    busy = false;
+    return true;
+}
+
+WorkerPool &WorkerPool::getShared() {
+    static WorkerPool pool(max(1, (int)thread::hardware_concurrency()) - 1);
+    return pool;
+}
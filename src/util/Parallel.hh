@@ -0,0 +1,93 @@
+#ifndef PARALLEL_HH
+#define PARALLEL_HH
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+/* Threads that wait around for jobs, so running something on every core
+doesn't mean starting and stopping threads each time. A job is split into
+slices, and the thread that asked for it works on slices too until they're
+all taken, then waits for the rest to finish. Only one job runs at a time. */
+class WorkerPool {
+    /* Runs the slice from start to stop of a job. */
+    typedef void (*Job)(void *context, int start, int stop);
+
+    std::vector<std::thread> workers;
+
+    /* Guards everything below it, and wakes workers when there's a job or
+    the thread that asked for it when the job is done. */
+    std::mutex m;
+    std::condition_variable wake;
+    std::condition_variable finished;
+
+    /* The job being run, and how it's split up. */
+    Job job;
+    void *context;
+    int count;
+    int slices;
+
+    /* The next slice nobody has started, and how many aren't done yet. */
+    int nextSlice;
+    int unfinished;
+
+    /* Goes up for each new job, so workers can tell there's one. */
+    unsigned int generation;
+    bool quit;
+
+    /* Whether a job is running, so jobs started from inside a job, or from
+    another thread in the meantime, don't wait on this one. */
+    std::atomic<bool> busy;
+
+    /* Run slices of the job until there are none left. m must be locked. */
+    void runSlices(std::unique_lock<std::mutex> &lock);
+
+    /* What each worker does until the pool is destroyed. */
+    void work();
+
+public:
+    /* Start that many workers, not counting the threads that ask for jobs. */
+    WorkerPool(int workerCount);
+
+    /* Stop and join the workers. There mustn't be a job running. */
+    ~WorkerPool();
+
+    /* How many threads a job can run on at once, counting the one that asked
+    for it. */
+    inline int getThreads() const {
+        return workers.size() + 1;
+    }
+
+    /* Split the numbers from 0 to count into that many about equal slices and
+    call job(context, start, stop) on each, returning once they're all done.
+    If a job is already running, do nothing and return false. */
+    bool run(int count, int sliceCount, Job job, void *context);
+
+    /* The pool everything shares, with a worker for every core but one. */
+    static WorkerPool &getShared();
+};
+
+/* Split the numbers from 0 to count into about equal slices and call
+fun(start, stop) on each slice, each on its own thread, and return once they
+are all done. No thread gets fewer than minEach numbers, so small jobs run
+on just this thread, and so do jobs started while another one is running. fun
+must be safe to run on different slices at once. */
+template<typename Fun>
+void parallelFor(int count, Fun fun, int minEach = 1) {
+    WorkerPool &pool = WorkerPool::getShared();
+    int threads = std::min(pool.getThreads(), count / std::max(minEach, 1));
+    auto slice = [](void *context, int start, int stop) {
+        (*(Fun *)context)(start, stop);
+    };
+    if (threads > 1 && pool.run(count, threads, slice, &fun)) {
+        return;
+    }
+    if (count > 0) {
+        fun(0, count);
+    }
+}
+
+#endif
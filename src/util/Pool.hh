@@ -0,0 +1,57 @@
+#ifndef POOL_HH
+#define POOL_HH
+
+#include <vector>
+#include <cstddef>
+#include <cassert>
+
+/* Memory for lots of objects that are all SIZE bytes, cut out of blocks of
+PER_BLOCK at a time. Freed objects are kept for the next one instead of going
+back to the heap, so making and deleting lots of objects only goes to the
+heap once in a while. This isn't safe to use from more than one thread. */
+template<size_t SIZE, size_t PER_BLOCK = 256>
+class Pool {
+    union Slot {
+        Slot *next;
+        alignas(std::max_align_t) unsigned char data[SIZE];
+    };
+
+    std::vector<Slot *> blocks;
+
+    /* Slots that aren't being used, linked through their next pointers. */
+    Slot *unused;
+
+public:
+    inline Pool() : unused(nullptr) {}
+
+    inline ~Pool() {
+        for (unsigned int i = 0; i < blocks.size(); i++) {
+            delete[] blocks[i];
+        }
+    }
+
+    Pool(const Pool &) = delete;
+    Pool &operator=(const Pool &) = delete;
+
+    inline void *allocate() {
+        if (unused == nullptr) {
+            blocks.push_back(new Slot[PER_BLOCK]);
+            for (size_t i = 0; i < PER_BLOCK; i++) {
+                blocks.back()[i].next = unused;
+                unused = &blocks.back()[i];
+            }
+        }
+        Slot *slot = unused;
+        unused = slot -> next;
+        return slot;
+    }
+
+    inline void release(void *pointer) {
+        assert(pointer != nullptr);
+        Slot *slot = (Slot *)pointer;
+        slot -> next = unused;
+        unused = slot;
+    }
+};
+
+#endif
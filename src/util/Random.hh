@@ -0,0 +1,55 @@
+#ifndef RANDOM_HH
+#define RANDOM_HH
+
+#include <cstdint>
+#include <cassert>
+
+/* Random numbers for the simulation. Instead of one generator that everything
+shares, each stream is made from a key, like the seed, the tick, and a place or
+an id, and the nth number in it only depends on the key and n. So anything
+that gets its own stream comes out the same no matter what else used random
+numbers first or which thread it ran on. The numbers come from the splitmix64
+finalizer, which is fast and plenty random enough for games. */
+class RandomStream {
+    uint64_t key;
+
+    /* How many numbers have been taken from this stream. */
+    uint64_t counter;
+
+    static inline uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+public:
+    /* Make a key out of up to five numbers. */
+    inline RandomStream(uint64_t a = 0, uint64_t b = 0, uint64_t c = 0,
+            uint64_t d = 0, uint64_t e = 0) : counter(0) {
+        key = a;
+        key = key * 0x9E3779B97F4A7C15ULL + b;
+        key = key * 0x9E3779B97F4A7C15ULL + c;
+        key = key * 0x9E3779B97F4A7C15ULL + d;
+        key = key * 0x9E3779B97F4A7C15ULL + e;
+    }
+
+    /* The next 64 random bits. */
+    inline uint64_t next() {
+        uint64_t z = key + counter * 0x9E3779B97F4A7C15ULL;
+        counter++;
+        return mix(z);
+    }
+
+    /* A random number from 0 up to but not including n. */
+    inline unsigned int below(unsigned int n) {
+        assert(n > 0);
+        return (unsigned int)(((next() >> 32) * n) >> 32);
+    }
+
+    /* A random number from 0 up to but not including 1. */
+    inline double fraction() {
+        return (double)(next() >> 11) / (double)((uint64_t)1 << 53);
+    }
+};
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef SLOTMAP_HH
+#define SLOTMAP_HH
+
+#include <vector>
+#include <cassert>
+
+/* Names something in a SlotMap. It stays good for as long as that thing is
+in there, no matter what else comes and goes, and doesn't get mixed up with
+whatever goes in the same slot after it's taken out. */
+struct SlotHandle {
+    unsigned int index;
+    unsigned int generation;
+};
+
+/* Holds pointers to things that come and go a lot. The pointers are packed
+together in no particular order, so going through all of them is going
+through a vector, and taking one out moves the last one into its place.
+Each thing also gets a slot that doesn't move, which is what handles point
+to. Empty slots get reused, so putting something in or taking it out never
+shifts anything. The slots are linked from oldest to newest, so it's quick
+to find the thing that's been in there longest. It doesn't own what's put
+in it. */
+template<class T>
+class SlotMap {
+    /* For slot links that don't go anywhere. */
+    static const unsigned int NONE = (unsigned int)-1;
+
+    struct Slot {
+        /* Where its pointer is in values, or if the slot is empty, the next
+        empty slot. */
+        unsigned int dense;
+
+        /* Goes up every time the slot is emptied, so old handles stop
+        working. */
+        unsigned int generation;
+
+        /* The slots that were filled just before and just after this one. */
+        unsigned int older;
+        unsigned int newer;
+
+        /* How many things had been put in before this slot was filled. */
+        unsigned long long added;
+    };
+
+    std::vector<T *> values;
+
+    /* Which slot each pointer in values belongs to. */
+    std::vector<unsigned int> slotOf;
+
+    std::vector<Slot> slots;
+
+    /* The first empty slot, and the ends of the oldest to newest list. */
+    unsigned int unused;
+    unsigned int oldest;
+    unsigned int newest;
+
+    /* How many things have ever been put in. */
+    unsigned long long inserted;
+
+public:
+    inline SlotMap() : unused(NONE), oldest(NONE), newest(NONE),
+        inserted(0) {}
+
+    /* Put something in, as the newest. */
+    inline SlotHandle insert(T *value) {
+        assert(value != nullptr);
+        unsigned int index = unused;
+        if (index == NONE) {
+            index = slots.size();
+            slots.push_back({0, 0, NONE, NONE, 0});
+        }
+        else {
+            unused = slots[index].dense;
+        }
+
+        Slot &slot = slots[index];
+        slot.dense = values.size();
+        slot.older = newest;
+        slot.newer = NONE;
+        slot.added = inserted;
+        inserted++;
+        if (newest == NONE) {
+            oldest = index;
+        }
+        else {
+            slots[newest].newer = index;
+        }
+        newest = index;
+
+        values.push_back(value);
+        slotOf.push_back(index);
+        return {index, slot.generation};
+    }
+
+    /* Take out the thing at position i and return it. The last thing moves
+    into position i. */
+    inline T *eraseAt(unsigned int i) {
+        assert(i < values.size());
+        T *value = values[i];
+        unsigned int index = slotOf[i];
+        values[i] = values.back();
+        slotOf[i] = slotOf.back();
+        slots[slotOf[i]].dense = i;
+        values.pop_back();
+        slotOf.pop_back();
+
+        Slot &slot = slots[index];
+        if (slot.older == NONE) {
+            oldest = slot.newer;
+        }
+        else {
+            slots[slot.older].newer = slot.newer;
+        }
+        if (slot.newer == NONE) {
+            newest = slot.older;
+        }
+        else {
+            slots[slot.newer].older = slot.older;
+        }
+        slot.generation++;
+        slot.dense = unused;
+        unused = index;
+        return value;
+    }
+
+    /* Take out the thing the handle names and return it. */
+    inline T *erase(SlotHandle handle) {
+        assert(contains(handle));
+        return eraseAt(slots[handle.index].dense);
+    }
+
+    /* Whether the thing the handle names is still in here. */
+    inline bool contains(SlotHandle handle) const {
+        return handle.index < slots.size()
+            && slots[handle.index].generation == handle.generation;
+    }
+
+    /* The thing the handle names, or nullptr if it's been taken out. */
+    inline T *get(SlotHandle handle) const {
+        if (!contains(handle)) {
+            return nullptr;
+        }
+        return values[slots[handle.index].dense];
+    }
+
+    inline SlotHandle getHandle(unsigned int i) const {
+        assert(i < values.size());
+        return {slotOf[i], slots[slotOf[i]].generation};
+    }
+
+    /* The position of the thing that was put in longest ago. */
+    inline unsigned int getOldest() const {
+        assert(!values.empty());
+        return slots[oldest].dense;
+    }
+
+    /* Whether the thing at position i was put in before the thing at
+    position j. */
+    inline bool isOlder(unsigned int i, unsigned int j) const {
+        assert(i < values.size() && j < values.size());
+        return slots[slotOf[i]].added < slots[slotOf[j]].added;
+    }
+
+    /* Access functions. Positions go from 0 up to size(), and change when
+    things are taken out. */
+    inline T *operator[](unsigned int i) const {
+        assert(i < values.size());
+        return values[i];
+    }
+
+    inline unsigned int size() const {
+        return values.size();
+    }
+
+    inline bool empty() const {
+        return values.empty();
+    }
+};
+
+#endif
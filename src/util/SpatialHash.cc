@@ -0,0 +1,66 @@
+#include "SpatialHash.hh"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+SpatialHash::SpatialHash(int cellSize) : cellSize(cellSize), worldWidth(1),
+        starts(2, 0) {
+    assert(cellSize > 0);
+}
+
+void SpatialHash::clear(int newWorldWidth) {
+    assert(newWorldWidth > 0);
+    worldWidth = newWorldWidth;
+    added.clear();
+}
+
+void SpatialHash::insert(int id, const Rect &rect) {
+    /* The bucket can't be worked out until we know how many buckets there
+    are, so save the cell for now. */
+    forCells(rect, [&](int cellX, int cellY) {
+        assert(cellX < 0x10000 && cellY < 0x10000);
+        added.emplace_back(((unsigned int)cellX << 16) | (unsigned int)cellY,
+            id);
+    });
+}
+
+void SpatialHash::finish() {
+    /* Have about twice as many buckets as cells in use, so few cells end up
+    sharing. */
+    unsigned int buckets = 16;
+    while (buckets < 2 * added.size()) {
+        buckets *= 2;
+    }
+    starts.assign(buckets + 1, 0);
+    for (unsigned int i = 0; i < added.size(); i++) {
+        unsigned int cell = added[i].first;
+        added[i].first = getBucket(cell >> 16, cell & 0xFFFF);
+        starts[added[i].first + 1]++;
+    }
+    for (unsigned int b = 0; b < buckets; b++) {
+        starts[b + 1] += starts[b];
+    }
+
+    /* Counting sort by bucket. */
+    entries.resize(added.size());
+    vector<int> next(starts.begin(), starts.end() - 1);
+    for (unsigned int i = 0; i < added.size(); i++) {
+        entries[next[added[i].first]++] = added[i].second;
+    }
+    added.clear();
+}
+
+void SpatialHash::query(const Rect &rect, vector<int> &found) const {
+    found.clear();
+    forCells(rect, [&](int cellX, int cellY) {
+        unsigned int bucket = getBucket(cellX, cellY);
+        found.insert(found.end(), entries.begin() + starts[bucket],
+            entries.begin() + starts[bucket + 1]);
+    });
+    /* Things in more than one cell, or cells that share a bucket, show up
+    more than once. */
+    sort(found.begin(), found.end());
+    found.erase(unique(found.begin(), found.end()), found.end());
+}
@@ -0,0 +1,83 @@
+#ifndef SPATIALHASH_HH
+#define SPATIALHASH_HH
+
+#include <vector>
+#include "../Rect.hh"
+
+/* Finds things near a place without looking at everything. The world is cut
+into square cells, and each thing is put in the cells its rect overlaps.
+There are far more cells than things, so cells share a fixed number of
+buckets, and a query looks at the buckets for the cells it covers. The world
+wraps around in the x direction, and rects that cross the edge go on both
+sides of it. It's meant to be rebuilt from scratch every tick. */
+class SpatialHash {
+    int cellSize;
+    int worldWidth;
+
+    /* The things in bucket b are entries[starts[b]] up to but not including
+    entries[starts[b + 1]]. */
+    std::vector<int> starts;
+    std::vector<int> entries;
+
+    /* Cell and id for each cell something was put in, before they get
+    sorted into buckets. The cell's x is in the high 16 bits. */
+    std::vector<std::pair<unsigned int, int>> added;
+
+    inline unsigned int getBucket(int cellX, int cellY) const {
+        unsigned int hash = (unsigned int)cellX * 73856093u
+            ^ (unsigned int)cellY * 19349663u;
+        return hash & (starts.size() - 2);
+    }
+
+    /* Call f(cellX, cellY) for each cell from left up to right, which must
+    already be on the map, and from bottom up to top. */
+    template<class F>
+    inline void forCells(int left, int right, int bottom, int top,
+            F f) const {
+        for (int i = left / cellSize; i <= (right - 1) / cellSize; i++) {
+            for (int j = bottom / cellSize; j <= (top - 1) / cellSize; j++) {
+                f(i, j);
+            }
+        }
+    }
+
+    /* Call f(cellX, cellY) for each cell the rect overlaps, going around the
+    edge of the world if it needs to. */
+    template<class F>
+    inline void forCells(const Rect &rect, F f) const {
+        int left = (rect.x % worldWidth + worldWidth) % worldWidth;
+        int right = left + std::max(rect.w, 1);
+        int bottom = std::max(rect.y, 0);
+        int top = std::max(rect.y + rect.h, bottom + 1);
+        if (right > worldWidth) {
+            forCells(left, worldWidth, bottom, top, f);
+            forCells(0, std::min(right - worldWidth, worldWidth), bottom, top,
+                f);
+        }
+        else {
+            forCells(left, right, bottom, top, f);
+        }
+    }
+
+public:
+    /* Cells should be about as big as the distances that get asked about. */
+    SpatialHash(int cellSize);
+
+    /* Forget everything and get ready to have things put in. */
+    void clear(int newWorldWidth);
+
+    /* Put something in. id is whatever the caller uses to find it again,
+    like an index into a vector. */
+    void insert(int id, const Rect &rect);
+
+    /* Sort everything that was put in into buckets. This has to happen
+    before anything can be found. */
+    void finish();
+
+    /* Set found to the ids of everything that might overlap the rect, from
+    lowest to highest, with no repeats. It might include things that are
+    nearby but don't overlap. */
+    void query(const Rect &rect, std::vector<int> &found) const;
+};
+
+#endif
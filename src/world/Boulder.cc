@@ -8,6 +8,7 @@
 #include <nlohmann/json.hpp>
 #include <fstream>
 #include <string>
+#include <algorithm> // For max
 
 #define BOULDER_CARRY_HEIGHT 1.5
 
@@ -27,7 +28,7 @@ std::set<TileType> Boulder::vectorConvert(const std::vector<int> &input) {
 
 /* Check if it can fall one tile. If it can, do. */
 bool Boulder::fall(Map &map, const Location &place, 
-        std::vector<DroppedItem*> &items) const {
+        SlotMap<DroppedItem> &items) const {
     TileType blocking = map.getTileType(place, 0, -1);
     /* If it can crush it, do so. */
     if (tilesCrushed.count(blocking)) {
@@ -44,7 +45,7 @@ bool Boulder::fall(Map &map, const Location &place,
 
 /* Try to move one tile. Return true on success. */
 bool Boulder::move(Map &map, const Location &place, int direction,
-        std::vector<DroppedItem*> &items) {
+        SlotMap<DroppedItem> &items) const {
     /* If it has no preference for direction, it should move sideways if
     that will let it fall. */
     if (direction == 0) {
@@ -53,7 +54,7 @@ bool Boulder::move(Map &map, const Location &place, int direction,
         }
 
         /* If it slides, pick a random direction (-1 or 1) to try to go. */
-        int newDirection = (rand() % 2) * 2 - 1;
+        int newDirection = (map.getTileRandom(place) % 2) * 2 - 1;
         assert(newDirection == -1 || newDirection == 1);
         move(map, place, newDirection, items);
         return true;
@@ -137,7 +138,7 @@ void Boulder::setDirection(Map &map, const Location &place, int direction)
 Return false if it didn't move and should therefore be removed from any
 lists of boulders to try to move. */
 bool Boulder::update(Map &map, Location place, 
-        std::vector<DroppedItem*> &items, int tick) {
+        SlotMap<DroppedItem> &items, int tick) const {
     /* If it can fall, it should. */
     if (fallTicks != 0 && (tick % fallTicks == 0) && !isFloating) {
         if (fall(map, place, items)) {
@@ -155,7 +156,48 @@ bool Boulder::update(Map &map, Location place,
     return true;
 }
 
-bool Boulder::canUpdate(const Map &map, const Location &place) {
+int Boulder::getUpdateDelay(int tick) const {
+    int delay = 0;
+    if (fallTicks != 0 && !isFloating) {
+        delay = fallTicks - tick % fallTicks;
+    }
+    if (moveTicks != 0) {
+        int moveDelay = moveTicks - tick % moveTicks;
+        if (delay == 0 || moveDelay < delay) {
+            delay = moveDelay;
+        }
+    }
+    return max(delay, 1);
+}
+
+void Boulder::catchUp(Map &map, Location place,
+        SlotMap<DroppedItem> &items, int ticks) const {
+    if (fallTicks == 0 || isFloating) {
+        return;
+    }
+    /* Find where it would have landed and go straight there, instead of a
+    tile at a time. Sideways moves aren't worth guessing at, since it picks
+    up where it left off anyway. */
+    int distance = 0;
+    while (distance < ticks / fallTicks && place.y - distance > 0) {
+        TileType below = map.getTileType(place, 0, -distance - 1);
+        if (!tilesCrushed.count(below) && !tilesSunk.count(below)) {
+            break;
+        }
+        distance++;
+    }
+    if (distance == 0) {
+        return;
+    }
+    if (tilesSunk.count(map.getTileType(place, 0, -distance))) {
+        map.displaceTile(place, 0, -distance);
+    }
+    else {
+        map.moveTile(place, 0, -distance, items);
+    }
+}
+
+bool Boulder::canUpdate(const Map &map, const Location &place) const {
     int direction = getDirection(map, place);
     return canUpdate(map, place, direction);
 }
@@ -47,11 +47,11 @@ class Boulder: public Tile {
 
     /* Try to fall one tile. Return true on success. */
     bool fall(Map &map, const Location &place, 
-        std::vector<DroppedItem*> &items) const;
+        SlotMap<DroppedItem> &items) const;
 
     /* Try to move one tile. Return true on success. */
     bool move(Map &map, const Location &place, int direction, 
-            std::vector<DroppedItem*> &items);
+            SlotMap<DroppedItem> &items) const;
 
     bool canUpdate(const Map &map, const Location &place, 
             int direction) const;
@@ -68,11 +68,18 @@ public:
     Return false if it didn't move and should therefore be removed from any
     lists of boulders to try to move. */
     virtual bool update(Map &map, Location place,  
-            std::vector<DroppedItem*> &items, 
-            int tick);
+            SlotMap<DroppedItem> &items, 
+            int tick) const;
+
+    /* The next tick it can fall or move sideways on. */
+    virtual int getUpdateDelay(int tick) const;
+
+    /* Fall as far as it would have in that many ticks. */
+    virtual void catchUp(Map &map, Location place,
+            SlotMap<DroppedItem> &items, int ticks) const;
 
     /* Look at the map and see if it can move, but don't do anything. */
-    virtual bool canUpdate(const Map &map, const Location &place);
+    virtual bool canUpdate(const Map &map, const Location &place) const;
 
     /* Figure out the direction to go from the tile sprite. */
     int getDirection(const Map &map, const Location &place) const;
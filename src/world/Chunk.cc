@@ -0,0 +1,127 @@
+#include "Chunk.hh"
+#include <string>
+#include <cassert>
+
+using namespace std;
+
+#define CHUNK_AREA (CHUNK_SIZE * CHUNK_SIZE)
+
+void Chunk::save(ostream &outfile) const {
+    outfile << "#Chunk\n";
+
+    /* Write each layer as pairs of how many of a tile in a row, and which
+    tile it is. */
+    for (int layer = 0; layer < 2; layer++) {
+        outfile << (layer == 0? "#Foreground\n" : "\n#Background\n");
+        int count = 0;
+        TileType last = TileType::EMPTY;
+        for (int i = 0; i < CHUNK_AREA; i++) {
+            TileType current = layer == 0? tiles[i].foreground
+                : tiles[i].background;
+            if (i != 0 && current != last) {
+                outfile << count << " " << (int)last << " ";
+                count = 1;
+            }
+            else {
+                count++;
+            }
+            last = current;
+        }
+        outfile << count << " " << (int)last << " ";
+    }
+
+    /* There aren't many biomes, so they don't need compressing. */
+    outfile << "\n#Biomes\n";
+    for (int i = 0; i < CHUNK_BIOMES * CHUNK_BIOMES; i++) {
+        outfile << (int)biomes[i].biome << " ";
+    }
+
+    outfile << "\n#Other\n";
+    for (int i = 0; i < CHUNK_AREA; i++) {
+        outfile << (int)tiles[i].foregroundVariant << " ";
+        outfile << (int)tiles[i].backgroundVariant << " ";
+    }
+
+    /* How full the water is, compressed like the layers. */
+    outfile << "\n#Liquid\n";
+    int count = 0;
+    int last = 0;
+    for (int i = 0; i < CHUNK_AREA; i++) {
+        if (i != 0 && tiles[i].liquid != last) {
+            outfile << count << " " << last << " ";
+            count = 1;
+        }
+        else {
+            count++;
+        }
+        last = tiles[i].liquid;
+    }
+    outfile << count << " " << last << " ";
+}
+
+bool Chunk::load(istream &infile) {
+    string header;
+    infile >> header;
+    if (header != "#Chunk") {
+        return false;
+    }
+
+    for (int layer = 0; layer < 2; layer++) {
+        infile >> header;
+        int index = 0;
+        while (index < CHUNK_AREA && infile) {
+            int count, tile;
+            infile >> count >> tile;
+            for (int i = 0; i < count && index < CHUNK_AREA; i++) {
+                if (layer == 0) {
+                    tiles[index].setForeground((TileType)tile);
+                }
+                else {
+                    tiles[index].background = (TileType)tile;
+                }
+                index++;
+            }
+        }
+    }
+
+    infile >> header;
+    for (int i = 0; i < CHUNK_BIOMES * CHUNK_BIOMES; i++) {
+        int biome;
+        infile >> biome;
+        biomes[i].biome = (BiomeType)biome;
+    }
+
+    infile >> header;
+    for (int i = 0; i < CHUNK_AREA; i++) {
+        int variant;
+        infile >> variant;
+        tiles[i].foregroundVariant = (uint8_t)variant;
+        infile >> variant;
+        tiles[i].backgroundVariant = (uint8_t)variant;
+    }
+    if (!infile) {
+        return false;
+    }
+
+    /* Chunks saved before water could flow don't say, and their water is
+    all full. */
+    header.clear();
+    infile >> header;
+    if (header == "#Liquid") {
+        int index = 0;
+        while (index < CHUNK_AREA && infile) {
+            int count, level;
+            infile >> count >> level;
+            for (int i = 0; i < count && index < CHUNK_AREA; i++) {
+                if (tiles[index].foreground == TileType::WATER
+                        && level != 0) {
+                    tiles[index].liquid = level;
+                }
+                index++;
+            }
+        }
+        return (bool)infile;
+    }
+
+    return true;
+}
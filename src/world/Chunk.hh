@@ -0,0 +1,50 @@
+#ifndef CHUNK_HH
+#define CHUNK_HH
+
+#include <iostream>
+#include "MapHelpers.hh"
+
+/* Chunks are squares of tiles CHUNK_SIZE wide, which are loaded, generated,
+saved, and unloaded together. The size has to be a power of two so finding a
+tile only takes shifts and masks. */
+#define CHUNK_SHIFT 6
+#define CHUNK_SIZE (1 << CHUNK_SHIFT)
+#define CHUNK_MASK (CHUNK_SIZE - 1)
+
+/* How many biome squares wide a chunk is. */
+#define CHUNK_BIOMES (CHUNK_SIZE / BIOME_SIZE)
+
+static_assert(CHUNK_SIZE % BIOME_SIZE == 0,
+    "Biomes can't be split between chunks.");
+
+/* A square piece of a map. */
+struct Chunk {
+    /* The tiles, a row at a time starting from the bottom, same as the map
+    used to store them. */
+    SpaceInfo tiles[CHUNK_SIZE * CHUNK_SIZE];
+
+    /* The biomes, in the same order. */
+    BiomeInfo biomes[CHUNK_BIOMES * CHUNK_BIOMES];
+
+    /* Return the SpaceInfo at x, y, where those are the tile coordinates
+    within this chunk. */
+    inline SpaceInfo *getSpace(int x, int y) {
+        return tiles + ((y & CHUNK_MASK) << CHUNK_SHIFT) + (x & CHUNK_MASK);
+    }
+
+    /* Return the BiomeInfo of the tile at x, y. Unlike getSpace, this takes
+    map coordinates. */
+    inline BiomeInfo *getBiome(int x, int y) {
+        return biomes + CHUNK_BIOMES * ((y & CHUNK_MASK) / BIOME_SIZE)
+            + (x & CHUNK_MASK) / BIOME_SIZE;
+    }
+
+    /* Write the chunk to a stream, using the same simple compression that
+    whole maps use. */
+    void save(std::ostream &outfile) const;
+
+    /* Read the chunk from a stream. Return false if it couldn't be read. */
+    bool load(std::istream &infile);
+};
+
+#endif
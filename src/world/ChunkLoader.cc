@@ -0,0 +1,144 @@
+#include "ChunkLoader.hh"
+#include "Mapgen.hh"
+#include <fstream>
+#include <cassert>
+#include <sys/stat.h> // For mkdir
+#include <dirent.h> // To list the chunk files
+#include <unistd.h> // For unlink
+
+using namespace std;
+
+ChunkLoader::ChunkLoader(string directory_in, int seed, int width,
+        int height) : directory(directory_in) {
+    chunksWide = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    busy = false;
+    quit = false;
+
+    /* Make sure there's somewhere to save to. It's fine if it already
+    exists. */
+    mkdir(directory.c_str(), 0755);
+
+    mapgen = new Mapgen();
+    mapgen -> setupChunks(seed, width, height);
+
+    worker = new thread(&ChunkLoader::run, this);
+}
+
+ChunkLoader::~ChunkLoader() {
+    m.lock();
+    quit = true;
+    m.unlock();
+    changed.notify_all();
+    worker -> join();
+    delete worker;
+    delete mapgen;
+
+    /* Nothing will collect these now. */
+    for (unsigned int i = 0; i < finished.size(); i++) {
+        delete finished[i].chunk;
+    }
+}
+
+void ChunkLoader::run() {
+    unique_lock<mutex> lock(m);
+    while (true) {
+        changed.wait(lock, [this]() { return quit || !jobs.empty(); });
+        if (jobs.empty()) {
+            /* Must be quitting, and everything's saved. */
+            return;
+        }
+
+        ChunkJob job = jobs.front();
+        jobs.pop_front();
+        busy = true;
+        lock.unlock();
+
+        if (job.chunk == nullptr) {
+            job.chunk = load(job.index);
+            lock.lock();
+            finished.push_back(job);
+        }
+        else {
+            save(job.index, *job.chunk);
+            delete job.chunk;
+            lock.lock();
+        }
+
+        busy = false;
+        changed.notify_all();
+    }
+}
+
+Chunk *ChunkLoader::load(int index) {
+    Chunk *chunk = new Chunk();
+    ifstream infile(getFilename(index));
+    if (infile && chunk -> load(infile)) {
+        return chunk;
+    }
+
+    /* It's never been saved, so it needs making. */
+    delete chunk;
+    chunk = new Chunk();
+    mapgen -> generateChunk(chunk, index % chunksWide, index / chunksWide);
+    return chunk;
+}
+
+string ChunkLoader::getFilename(int index) const {
+    return directory + "/" + to_string(index % chunksWide) + "_"
+        + to_string(index / chunksWide) + ".chunk";
+}
+
+void ChunkLoader::request(int index) {
+    m.lock();
+    jobs.push_back({index, nullptr});
+    m.unlock();
+    changed.notify_all();
+}
+
+void ChunkLoader::release(int index, Chunk *chunk) {
+    assert(chunk);
+    m.lock();
+    jobs.push_back({index, chunk});
+    m.unlock();
+    changed.notify_all();
+}
+
+void ChunkLoader::save(int index, const Chunk &chunk) const {
+    ofstream outfile(getFilename(index));
+    if (!outfile) {
+        cerr << "Can't save chunk to " << getFilename(index) << "\n";
+        return;
+    }
+    chunk.save(outfile);
+}
+
+vector<ChunkJob> ChunkLoader::collect() {
+    vector<ChunkJob> done;
+    m.lock();
+    done.swap(finished);
+    m.unlock();
+    return done;
+}
+
+void ChunkLoader::wait() {
+    unique_lock<mutex> lock(m);
+    changed.wait(lock, [this]() { return jobs.empty() && !busy; });
+}
+
+void ChunkLoader::clear(string directory) {
+    DIR *dir = opendir(directory.c_str());
+    if (dir == nullptr) {
+        return;
+    }
+
+    const string extension = ".chunk";
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        string name = entry -> d_name;
+        if (name.size() > extension.size() && name.compare(name.size() 
+                - extension.size(), extension.size(), extension) == 0) {
+            unlink((directory + "/" + name).c_str());
+        }
+    }
+    closedir(dir);
+}
@@ -0,0 +1,90 @@
+#ifndef CHUNKLOADER_HH
+#define CHUNKLOADER_HH
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Chunk.hh"
+
+class Mapgen;
+
+/* A chunk and where it goes in its map's table of chunks. */
+struct ChunkJob {
+    int index;
+    Chunk *chunk;
+};
+
+/* Loads the chunks of a streamed map on a background thread, from disk if
+they've been saved before and by generating them if not. Chunks the map is
+done with get saved and deleted on the same thread. */
+class ChunkLoader {
+    /* The folder the chunk files are in. */
+    std::string directory;
+
+    /* How many chunks wide the map is. */
+    int chunksWide;
+
+    /* Makes chunks that have never been saved. Only the worker thread uses
+    it once it's running. */
+    Mapgen *mapgen;
+
+    std::thread *worker;
+
+    /* Guards everything below. */
+    std::mutex m;
+    std::condition_variable changed;
+
+    /* Chunks to load (if chunk is nullptr) or save and delete, in the order
+    they were asked for, so a chunk that gets unloaded and then loaded again
+    is always read back after it was written. */
+    std::deque<ChunkJob> jobs;
+
+    /* Chunks that finished loading but haven't been collected. */
+    std::vector<ChunkJob> finished;
+
+    /* Whether the worker is partway through a job. */
+    bool busy;
+
+    /* Set when the worker should stop once it's out of jobs. */
+    bool quit;
+
+    /* What the worker thread does. */
+    void run();
+
+    /* Load or generate a chunk. */
+    Chunk *load(int index);
+
+    /* Return the name of the file the chunk is saved in. */
+    std::string getFilename(int index) const;
+
+public:
+    /* Set up chunk generation for a map with this seed and size, which can
+    take a little while, and then start the worker. */
+    ChunkLoader(std::string directory_in, int seed, int width, int height);
+
+    /* Finish every job (so everything gets saved), then stop the worker. */
+    ~ChunkLoader();
+
+    /* Ask for a chunk to be loaded. */
+    void request(int index);
+
+    /* Give a chunk to be saved and deleted. */
+    void release(int index, Chunk *chunk);
+
+    /* Save a chunk right now, on this thread. */
+    void save(int index, const Chunk &chunk) const;
+
+    /* Return every chunk that has finished loading since last time. */
+    std::vector<ChunkJob> collect();
+
+    /* Wait until every job so far is done. */
+    void wait();
+
+    /* Delete every chunk file in a folder. */
+    static void clear(std::string directory);
+};
+
+#endif
@@ -0,0 +1,156 @@
+#include "LiquidFlow.hh"
+#include "Map.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+SpaceInfo *LiquidFlow::find(Map &map, int x, int y) const {
+    if (y < 0 || y >= map.height) {
+        return nullptr;
+    }
+    if (x < 0) {
+        x += map.width;
+    }
+    else if (x >= map.width) {
+        x -= map.width;
+    }
+    Chunk *chunk = map.getChunk(x, y);
+    return chunk == nullptr? nullptr : chunk -> getSpace(x, y);
+}
+
+bool LiquidFlow::canHold(const Map &map, const SpaceInfo *space) const {
+    if (space == nullptr) {
+        return false;
+    }
+    TileType type = space -> foreground;
+    return type == TileType::EMPTY || type == TileType::WATER
+        || map.getTile(type) -> getWaterBreaks();
+}
+
+void LiquidFlow::transfer(Map &map, int fromX, int fromY, SpaceInfo *from,
+        int toX, int toY, SpaceInfo *to, int amount) {
+    assert(0 < amount);
+    assert(amount <= from -> liquid);
+    assert(to -> liquid + amount <= LIQUID_FULL);
+    toX = map.wrapX(toX);
+
+    if (to -> liquid == 0) {
+        changed.emplace_back(toX, toY, MapLayer::FOREGROUND);
+    }
+    to -> liquid += amount;
+    from -> liquid -= amount;
+    if (from -> liquid == 0) {
+        changed.emplace_back(fromX, fromY, MapLayer::FOREGROUND);
+    }
+
+    /* Whatever was above or beside the tile it left might be able to flow
+    into it now. */
+    map.wakeLiquid(fromX, fromY);
+    map.wakeLiquid(fromX, fromY + 1);
+    map.wakeLiquid(fromX - 1, fromY);
+    map.wakeLiquid(fromX + 1, fromY);
+    map.wakeLiquid(toX, toY);
+}
+
+void LiquidFlow::setChanged(Map &map, SlotMap<DroppedItem> &items) {
+    for (unsigned int i = 0; i < changed.size(); i++) {
+        int x = changed[i].x;
+        int y = changed[i].y;
+        SpaceInfo *space = find(map, x, y);
+        assert(space != nullptr);
+        uint8_t level = space -> liquid;
+        if (level != 0 && space -> foreground != TileType::WATER) {
+            /* Anything the water can go through gets washed away. */
+            if (space -> foreground != TileType::EMPTY) {
+                map.kill(x, y, MapLayer::FOREGROUND, items);
+            }
+            map.setTile(x, y, MapLayer::FOREGROUND, TileType::WATER);
+            map.setForegroundVariant(x, y, 0);
+            space -> liquid = level;
+        }
+        else if (level == 0 && space -> foreground == TileType::WATER) {
+            map.setTile(x, y, MapLayer::FOREGROUND, TileType::EMPTY);
+        }
+    }
+    changed.clear();
+}
+
+void LiquidFlow::flow(Map &map, int x, int y) {
+    SpaceInfo *space = find(map, x, y);
+    if (space == nullptr || space -> liquid == 0) {
+        return;
+    }
+
+    /* Fill up whatever is below first. */
+    SpaceInfo *below = find(map, x, y - 1);
+    if (canHold(map, below) && below -> liquid < LIQUID_FULL) {
+        int amount = min((int)space -> liquid, LIQUID_FULL - below -> liquid);
+        transfer(map, x, y, space, x, y - 1, below, amount);
+        if (space -> liquid == 0) {
+            return;
+        }
+    }
+
+    /* Then even out with each side, a third of the difference at a time so
+    that this tile never ends up lower than the ones it flowed into. Small
+    differences are left alone, so puddles settle instead of sloshing back
+    and forth forever. */
+    SpaceInfo *left = find(map, x - 1, y);
+    SpaceInfo *right = find(map, x + 1, y);
+    int level = space -> liquid;
+    int toLeft = canHold(map, left)? (level - left -> liquid) / 3 : 0;
+    int toRight = canHold(map, right)? (level - right -> liquid) / 3 : 0;
+    if (toLeft > 0) {
+        transfer(map, x, y, space, x - 1, y, left, toLeft);
+    }
+    if (toRight > 0) {
+        transfer(map, x, y, space, x + 1, y, right, toRight);
+    }
+}
+
+void LiquidFlow::resize(int chunkCount) {
+    awakeTiles.assign(chunkCount * CHUNK_SIZE, 0);
+    isAwake.assign(chunkCount, false);
+    awakeChunks.clear();
+}
+
+void LiquidFlow::sleep(int index) {
+    fill(awakeTiles.begin() + index * CHUNK_SIZE,
+        awakeTiles.begin() + (index + 1) * CHUNK_SIZE, 0);
+}
+
+void LiquidFlow::update(Map &map, unsigned int tick,
+        SlotMap<DroppedItem> &items) {
+    /* Anything woken while this runs waits for the next tick, unless it's
+    in a chunk that hasn't had its turn yet. */
+    vector<int> chunks;
+    chunks.swap(awakeChunks);
+    sort(chunks.begin(), chunks.end());
+
+    uint64_t rows[CHUNK_SIZE];
+    for (unsigned int i = 0; i < chunks.size(); i++) {
+        int index = chunks[i];
+        isAwake[index] = false;
+        vector<uint64_t>::iterator awake = awakeTiles.begin()
+            + index * CHUNK_SIZE;
+        copy(awake, awake + CHUNK_SIZE, rows);
+        fill(awake, awake + CHUNK_SIZE, 0);
+
+        int left = (index % map.chunksWide) * CHUNK_SIZE;
+        int bottom = (index / map.chunksWide) * CHUNK_SIZE;
+        for (int row = 0; row < CHUNK_SIZE; row++) {
+            uint64_t bits = rows[row];
+            /* Go left to right on even ticks and right to left on odd ones,
+            so water doesn't drift one way. */
+            while (bits != 0) {
+                int bit = tick % 2 == 0? __builtin_ctzll(bits)
+                    : 63 - __builtin_clzll(bits);
+                bits &= ~((uint64_t)1 << bit);
+                flow(map, left + bit, bottom + row);
+            }
+        }
+    }
+
+    setChanged(map, items);
+}
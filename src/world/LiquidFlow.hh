@@ -0,0 +1,82 @@
+#ifndef LIQUIDFLOW_HH
+#define LIQUIDFLOW_HH
+
+#include <vector>
+#include <cstdint>
+#include "Chunk.hh"
+#include "../util/SlotMap.hh"
+
+class Map;
+class DroppedItem;
+struct SpaceInfo;
+
+static_assert(CHUNK_SIZE == 64, "Each row of a chunk needs to fit in a "
+    "uint64_t.");
+
+/* Moves liquid around the map. Each tile holds a level of liquid from 0 to
+LIQUID_FULL, which first flows down into whatever has room and then spreads
+out sideways towards lower levels. Only tiles that were woken get looked at,
+a bit per tile, so a lake that has settled costs nothing. Chunks with no
+awake tiles are asleep and aren't even looked at. */
+class LiquidFlow {
+    /* A bit for each tile to look at next tick. Each chunk has CHUNK_SIZE
+    rows, starting from the bottom, with bit i being x = i in the chunk. */
+    std::vector<uint64_t> awakeTiles;
+
+    /* The chunks with any awake tiles, and whether each chunk is in that
+    list. */
+    std::vector<int> awakeChunks;
+    std::vector<bool> isAwake;
+
+    /* Tiles that gained or lost all their liquid this tick. While liquid
+    flows only the levels change, and these get their foreground set to water
+    or empty at the end. That way a falling column of water only changes the
+    tiles at its top and bottom, not every tile in it. */
+    std::vector<Location> changed;
+
+    /* Return the space at x, y, or nullptr if it's off the top or bottom of
+    the map or not loaded. x can be up to one map width out of range. */
+    SpaceInfo *find(Map &map, int x, int y) const;
+
+    /* Whether liquid can go in this space. The foreground might not have
+    caught up with the liquid yet, but tiles that water breaks can hold it
+    anyway. */
+    bool canHold(const Map &map, const SpaceInfo *space) const;
+
+    /* Move amount of liquid from one tile to another, which must be able to
+    hold it, and wake up whatever might flow because of it. Only the levels
+    change. */
+    void transfer(Map &map, int fromX, int fromY, SpaceInfo *from, int toX,
+        int toY, SpaceInfo *to, int amount);
+
+    /* Make the foreground of each changed tile match its liquid. */
+    void setChanged(Map &map, SlotMap<DroppedItem> &items);
+
+    /* Let the liquid at x, y flow for a tick. */
+    void flow(Map &map, int x, int y);
+
+public:
+    /* Make room for that many chunks, none of them awake. */
+    void resize(int chunkCount);
+
+    /* Look at the tile x, y of chunk index next tick. x and y can be map
+    coordinates. */
+    inline void wake(int index, int x, int y) {
+        awakeTiles[index * CHUNK_SIZE + (y & CHUNK_MASK)]
+            |= (uint64_t)1 << (x & CHUNK_MASK);
+        if (!isAwake[index]) {
+            isAwake[index] = true;
+            awakeChunks.push_back(index);
+        }
+    }
+
+    /* Forget about the awake tiles in a chunk, for when it's unloaded. */
+    void sleep(int index);
+
+    /* Let every awake tile flow, a chunk at a time from the bottom of the
+    map up. */
+    void update(Map &map, unsigned int tick,
+        SlotMap<DroppedItem> &items);
+};
+
+#endif
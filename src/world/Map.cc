@@ -7,15 +7,34 @@
 #include <tgmath.h> // for exponentiation
 #include "Map.hh"
 #include "Boulder.hh"
+#include "ChunkLoader.hh"
 #include "../version.hh"
 #include "../entity/DroppedItem.hh"
 #include "../action/ItemMaker.hh"
+#include "../util/Parallel.hh"
 #include <queue>
+#include <algorithm> // For sort
+#include <cstdint> // For uint64_t
+#include <chrono> // For timing tile updates
 
 #define MAX_LIGHT_DEPTH 5
 
+/* Rows of pixels each thread should get at least, when making pictures of the
+map, so that small pictures don't bother starting threads. */
+#define ROWS_PER_THREAD 32
+
 using namespace std;
 
+/* Write an image to a binary PPM file. The pixels go a row at a time from
+the top, with a red, green, and blue byte for each. */
+static void writePPM(string filename, int width, int height,
+        const vector<unsigned char> &pixels) {
+    assert((int)pixels.size() == 3 * width * height);
+    ofstream outfile(filename, ios::binary);
+    outfile << "P6\n" << width << " " << height << "\n255\n";
+    outfile.write((const char *)pixels.data(), pixels.size());
+}
+
 Tile *Map::newTile(TileType val) {
     Tile *tile = nullptr;
         switch(val) {
@@ -120,13 +139,313 @@ Tile *Map::newTile(TileType val) {
     return tile;
 }
 
+thread_local SpaceInfo Map::unloadedSpace;
+thread_local TileUpdateBatch *Map::batch = nullptr;
+
+SpaceInfo *Map::getUnloaded() const {
+    unloadedSpace = SpaceInfo();
+    unloadedSpace.foreground = TileType::STONE;
+    unloadedSpace.background = TileType::STONE;
+    /* Don't try to relight it. */
+    unloadedSpace.isLightUpdated = true;
+    return &unloadedSpace;
+}
+
+void Map::makeChunkTable() {
+    chunksWide = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    chunksHigh = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    assert(chunks.empty());
+    chunks.resize(chunksWide * chunksHigh, nullptr);
+    activeTiles.resize(chunks.size(), 0);
+    liquids.resize(chunks.size());
+    isSimulated.resize(chunks.size(), false);
+    frozenSince.resize(chunks.size(), 0);
+    fields.resize(chunks.size());
+}
+
+void Map::makeAllChunks() {
+    for (unsigned int i = 0; i < chunks.size(); i++) {
+        assert(chunks[i] == nullptr);
+        chunks[i] = new Chunk();
+        loadedChunks.insert(i);
+    }
+}
+
+void Map::setField(int chunkX, int chunkY, const PhysicsField &field) {
+    assert(0 <= chunkX && chunkX < chunksWide);
+    assert(0 <= chunkY && chunkY < chunksHigh);
+    fields[chunkY * chunksWide + chunkX] = field;
+}
+
+PhysicsSample Map::getPhysics(int x, int y) const {
+    const PhysicsField &field = getField(x, y);
+    PhysicsSample sample;
+    sample.gravity = gravity * field.gravityScale + field.lift;
+    sample.dragX = field.dragX;
+    sample.dragY = field.dragY;
+    if (0 <= y && y < height && getLiquid(x, y) != 0) {
+        sample.dragX *= WATER_DRAG_X;
+        sample.dragY *= WATER_DRAG_Y;
+    }
+    return sample;
+}
+
+void Map::addChunk(int index, Chunk *chunk) {
+    assert(chunks[index] == nullptr);
+    chunks[index] = chunk;
+    loadedChunks.insert(index);
+    requestedChunks.erase(index);
+    /* It can't have missed anything while it wasn't loaded. */
+    frozenSince[index] = tick;
+
+    int left = (index % chunksWide) * CHUNK_SIZE;
+    int bottom = (index / chunksWide) * CHUNK_SIZE;
+    refreshOverview(left, min(left + CHUNK_SIZE, width), bottom,
+        min(bottom + CHUNK_SIZE, height));
+
+    /* Things next to the chunk were next to solid stone until now, so they
+    get rechecked too. */
+    int top = min(bottom + CHUNK_SIZE + 1, height);
+    for (int y = max(bottom - 1, 0); y < top; y++) {
+        for (int x = left - 1; x <= left + CHUNK_SIZE; x++) {
+            addToUpdate(wrapX(x), y, MapLayer::FOREGROUND);
+            addToUpdate(wrapX(x), y, MapLayer::BACKGROUND);
+            addToUpdate(wrapX(x), y, MapLayer::LIQUID);
+            findPointer(x, y) -> isLightUpdated = false;
+        }
+    }
+}
+
+void Map::removeChunk(int index) {
+    assert(loader);
+    assert(chunks[index] != nullptr);
+
+    /* Stop updating anything in it. */
+    if (isSimulated[index]) {
+        freeze(index);
+    }
+
+    loader -> release(index, chunks[index]);
+    chunks[index] = nullptr;
+    loadedChunks.erase(index);
+}
+
+void Map::freeze(int index) {
+    assert(isSimulated[index]);
+    /* Chunks that are asleep have nothing to stop. */
+    if (activeTiles[index] != 0) {
+        toUpdate.cancelIf([this, index](const Location &place) {
+            return getChunkIndex(place.x, place.y) == index;
+        });
+        activeTiles[index] = 0;
+    }
+    liquids.sleep(index);
+    isSimulated[index] = false;
+    frozenSince[index] = tick;
+    simulatedChunks.erase(find(simulatedChunks.begin(),
+        simulatedChunks.end(), index));
+}
+
+void Map::thaw(int index, SlotMap<DroppedItem> &items) {
+    assert(!isSimulated[index]);
+    assert(chunks[index] != nullptr);
+    isSimulated[index] = true;
+    simulatedChunks.push_back(index);
+
+    int left = (index % chunksWide) * CHUNK_SIZE;
+    int bottom = (index / chunksWide) * CHUNK_SIZE;
+    int right = min(left + CHUNK_SIZE, width);
+    int top = min(bottom + CHUNK_SIZE, height);
+
+    /* Rather than replaying every tick it missed, let each tile guess
+    where it would be by now. Going from the bottom up means falling tiles
+    land on whatever already fell. */
+    int missed = tick - frozenSince[index];
+    if (missed > 0) {
+        for (int y = bottom; y < top; y++) {
+            for (int x = left; x < right; x++) {
+                Location place(x, y, MapLayer::FOREGROUND);
+                getTile(place) -> catchUp(*this, place, items, missed);
+            }
+        }
+    }
+
+    for (int y = bottom; y < top; y++) {
+        for (int x = left; x < right; x++) {
+            addToUpdate(x, y, MapLayer::FOREGROUND);
+            addToUpdate(x, y, MapLayer::BACKGROUND);
+            if (chunks[index] -> getSpace(x, y) -> liquid != 0) {
+                liquids.wake(index, x, y);
+            }
+        }
+    }
+}
+
+void Map::simulateNear(int x, int y) {
+    int chunkX = wrapX(x) >> CHUNK_SHIFT;
+    int chunkY = min(max(y, 0), height - 1) >> CHUNK_SHIFT;
+    for (int j = max(chunkY - simulationRadius, 0);
+            j <= min(chunkY + simulationRadius, chunksHigh - 1); j++) {
+        for (int i = chunkX - simulationRadius;
+                i <= chunkX + simulationRadius; i++) {
+            nearPlayers.insert(j * chunksWide
+                + (i % chunksWide + chunksWide) % chunksWide);
+        }
+    }
+}
+
+void Map::updateSimulated(SlotMap<DroppedItem> &items) {
+    vector<int> far;
+    for (unsigned int i = 0; i < simulatedChunks.size(); i++) {
+        if (!nearPlayers.count(simulatedChunks[i])) {
+            far.push_back(simulatedChunks[i]);
+        }
+    }
+    for (unsigned int i = 0; i < far.size(); i++) {
+        freeze(far[i]);
+    }
+
+    /* Chunks that are still loading get thawed once they're in. */
+    for (int index : nearPlayers) {
+        if (!isSimulated[index] && chunks[index] != nullptr) {
+            thaw(index, items);
+        }
+    }
+    nearPlayers.clear();
+}
+
+int Map::chunkDistance(int index, int chunkX, int chunkY) const {
+    int dx = abs(index % chunksWide - chunkX);
+    dx = min(dx, chunksWide - dx);
+    int dy = abs(index / chunksWide - chunkY);
+    return max(dx, dy);
+}
+
+void Map::refreshOverview(int left, int right, int bottom, int top) {
+    int shift = overview.getShift();
+    int pixelLeft = left >> shift;
+    int pixelRight = ((right - 1) >> shift) + 1;
+    int pixelBottom = bottom >> shift;
+    int pixelTop = ((top - 1) >> shift) + 1;
+
+    /* Each pixel is the average color of the loaded tiles it covers. */
+    parallelFor(pixelTop - pixelBottom, [&](int start, int stop) {
+        for (int py = pixelBottom + start; py < pixelBottom + stop; py++) {
+            for (int px = pixelLeft; px < pixelRight; px++) {
+                int r = 0;
+                int g = 0;
+                int b = 0;
+                int known = 0;
+                int yStop = min((py + 1) << shift, height);
+                int xStop = min((px + 1) << shift, width);
+                for (int y = py << shift; y < yStop; y++) {
+                    for (int x = px << shift; x < xStop; x++) {
+                        const SpaceInfo *space = peek(x, y);
+                        if (space != nullptr) {
+                            Light color = getTile(space -> foreground)
+                                -> getColor();
+                            r += color.r;
+                            g += color.g;
+                            b += color.b;
+                            known++;
+                        }
+                    }
+                }
+                if (known == 0) {
+                    overview.setPixel(px, py, Light(0, 0, 0, 0));
+                }
+                else {
+                    overview.setPixel(px, py, Light(r / known, g / known,
+                        b / known, 255));
+                }
+            }
+        }
+    }, ROWS_PER_THREAD);
+
+    overview.propagate(pixelLeft, pixelRight, pixelBottom, pixelTop);
+}
+
+void Map::buildOverview() {
+    overview.resize(width, height);
+    refreshOverview(0, width, 0, height);
+}
+
+void Map::streamChunks(int x, int y) {
+    if (!streamed) {
+        return;
+    }
+    assert(loader);
+
+    /* Move in anything that's ready. */
+    vector<ChunkJob> ready = loader -> collect();
+    for (unsigned int i = 0; i < ready.size(); i++) {
+        addChunk(ready[i].index, ready[i].chunk);
+    }
+
+    int chunkX = wrapX(x) >> CHUNK_SHIFT;
+    int chunkY = min(max(y, 0), height - 1) >> CHUNK_SHIFT;
+
+    /* Ask for nearby chunks, closest first so the ones the player is about
+    to walk into come soonest. */
+    for (int r = 0; r <= CHUNK_LOAD_RADIUS; r++) {
+        for (int j = chunkY - r; j <= chunkY + r; j++) {
+            if (j < 0 || j >= chunksHigh) {
+                continue;
+            }
+            for (int i = chunkX - r; i <= chunkX + r; i++) {
+                int index = j * chunksWide + (i + chunksWide) % chunksWide;
+                if (chunks[index] == nullptr 
+                        && !requestedChunks.count(index)) {
+                    requestedChunks.insert(index);
+                    loader -> request(index);
+                }
+            }
+        }
+    }
+
+    /* Send far away chunks off to be saved. */
+    vector<int> far;
+    for (int index : loadedChunks) {
+        if (chunkDistance(index, chunkX, chunkY) > CHUNK_UNLOAD_RADIUS) {
+            far.push_back(index);
+        }
+    }
+    for (unsigned int i = 0; i < far.size(); i++) {
+        removeChunk(far[i]);
+    }
+}
+
+Map::~Map() {
+    /* Save everything that's left, for streamed maps, and delete it. The
+    loader saves the chunks itself before it stops. */
+    if (loader) {
+        vector<int> loaded(loadedChunks.begin(), loadedChunks.end());
+        for (unsigned int i = 0; i < loaded.size(); i++) {
+            loader -> release(loaded[i], chunks[loaded[i]]);
+            chunks[loaded[i]] = nullptr;
+        }
+        delete loader;
+    }
+    for (unsigned int i = 0; i < chunks.size(); i++) {
+        delete chunks[i];
+    }
+
+    /* Delete each tile object. */
+    while (pointers.empty() == false) {
+        delete pointers.back();
+        pointers.pop_back();
+    }
+}
+
 void Map::initializeVariants() {
     for (int x = 0; x < width; ++x) {
         for (int y = 0; y < height; ++y) {
-            setForegroundVariant(x, y, 
-                getForeground(x, y) -> getInitialVariant());
-            setBackgroundVariant(x, y, 
-                getBackground(x, y) -> getInitialVariant());
+            Location front(x, y, MapLayer::FOREGROUND);
+            Location back(x, y, MapLayer::BACKGROUND);
+            setForegroundVariant(x, y, getForeground(x, y)
+                -> getInitialVariant(getTileRandom(front)));
+            setBackgroundVariant(x, y, getBackground(x, y)
+                -> getInitialVariant(getTileRandom(back)));
         }
     }
 }
@@ -365,18 +684,23 @@ void Map::updateNear(int x, int y) {
     /* Value that takes into account x-wrapping of the map. */
     Location fore;
     Location back;
+    Location liquid;
     fore.layer = MapLayer::FOREGROUND;
     back.layer = MapLayer::BACKGROUND;
+    liquid.layer = MapLayer::LIQUID;
     for (int i = -1; i < 2; i++) {
         fore.x = wrapX(x + i);
         back.x = wrapX(x + i);
+        liquid.x = wrapX(x + i);
         for (int j = -1; j < 2; j++) {
             if (isOnMap(wrapX(x + i), y + j)) {
                 fore.y = y + j;
                 back.y = y + j;
+                liquid.y = y + j;
                 /* Update the tiles. */
                 addToUpdate(fore);
                 addToUpdate(back);
+                addToUpdate(liquid);
             }
         }
     }
@@ -429,15 +753,16 @@ void Map::saveLayer(MapLayer layer, ofstream &outfile) const {
     assert(height != 0);
     assert(width != 0);
 
-    // Treat the array as the 1D array it is.
+    // Go a row at a time, like the map used to be stored.
     for (int index = 0; index < height * width; index++) {
         /* Get a tiletype from the correct layer. */
+        SpaceInfo *space = findPointer(index % width, index / width);
         if (layer == MapLayer::FOREGROUND) {
-            current = tiles[index].foreground;
+            current = space -> foreground;
         }
         else {
             assert(layer == MapLayer::BACKGROUND);
-            current = tiles[index].background;
+            current = space -> background;
         }
         if(index != 0 && current != last) {
             outfile << count << " ";
@@ -454,6 +779,25 @@ void Map::saveLayer(MapLayer layer, ofstream &outfile) const {
     outfile << count << " " << (int)last << " ";
 }
 
+void Map::saveLiquid(ofstream &outfile) const {
+    /* Most of the map is either empty or full, so this compresses the same
+    way as the layers. */
+    int count = 0;
+    int last = 0;
+    for (int index = 0; index < height * width; index++) {
+        int current = findPointer(index % width, index / width) -> liquid;
+        if (index != 0 && current != last) {
+            outfile << count << " " << last << " ";
+            count = 1;
+        }
+        else {
+            count++;
+        }
+        last = current;
+    }
+    outfile << count << " " << last << " ";
+}
+
 void Map::save(std::string filename) const {
     // Saves in .bmp file format in black and white
     std::ofstream outfile;
@@ -464,6 +808,35 @@ void Map::save(std::string filename) const {
     outfile << width << " " << height << "\n";
     outfile << spawn.x << " " << spawn.y << "\n";
     outfile << seed << "\n";
+
+    /* The world's gravity, then the index and field of each chunk that has
+    something other than the default. */
+    outfile << "#Physics\n" << gravity << "\n";
+    int changed = 0;
+    for (unsigned int i = 0; i < fields.size(); i++) {
+        changed += !fields[i].isDefault();
+    }
+    outfile << changed << "\n";
+    for (unsigned int i = 0; i < fields.size(); i++) {
+        if (!fields[i].isDefault()) {
+            outfile << i << " " << fields[i].gravityScale << " "
+                << fields[i].lift << " " << fields[i].dragX << " "
+                << fields[i].dragY << "\n";
+        }
+    }
+
+    /* Streamed maps keep their tiles in a file for each chunk. */
+    if (streamed) {
+        outfile << "#Streamed\n";
+        outfile.close();
+        if (loader) {
+            for (int index : loadedChunks) {
+                loader -> save(index, *chunks[index]);
+            }
+        }
+        return;
+    }
+
     // Write tile values
     outfile << "#Foreground\n";
     saveLayer(MapLayer::FOREGROUND, outfile);
@@ -474,7 +847,6 @@ void Map::save(std::string filename) const {
 
     /* Biome information. */
     outfile << "\n#Biomes\n";
-    assert(biomes.size() == (unsigned int)(biomesWide * biomesHigh));
     assert(biomesWide != 0);
     assert(biomesHigh != 0);
 
@@ -486,7 +858,11 @@ void Map::save(std::string filename) const {
     */
     BiomeType last = BiomeType::GRASSLAND;
     for (int i = 0; i < biomesWide * biomesHigh; i++) {
-        current = biomes[i].biome;
+        /* The biome array goes a little past the edge of the map, and the
+        part off the edge is the same as the edge. */
+        int x = min((i % biomesWide) * BIOME_SIZE, width - 1);
+        int y = min((i / biomesWide) * BIOME_SIZE, height - 1);
+        current = getChunk(x, y) -> getBiome(x, y) -> biome;
         if (i != 0 && current != last) {
             outfile << count << " " << (int)last << " ";
             count = 1;
@@ -503,10 +879,16 @@ void Map::save(std::string filename) const {
     /* All the other data. */
     outfile << "\n#Other\n";
     for (int i = 0; i < width * height; i++) {
-        outfile << (int)tiles[i].foregroundVariant << " ";
-        outfile << (int)tiles[i].backgroundVariant << " ";
+        SpaceInfo *space = findPointer(i % width, i / width);
+        outfile << (int)space -> foregroundVariant << " ";
+        outfile << (int)space -> backgroundVariant << " ";
     }
 
+    /* How full the water is. Maps saved before there was flowing water
+    don't have this, and all their water is full. */
+    outfile << "\n#Liquid\n";
+    saveLiquid(outfile);
+
     outfile.close();
 }
 
@@ -519,17 +901,10 @@ void Map::loadLayer(MapLayer layer, ifstream &infile) {
         current = (TileType)tile;
         for (int i = 0; i < count; i++) {
             assert(index < width * height);
-            if (layer == MapLayer::FOREGROUND) {
-                tiles[index].foreground  = current;
-            }
-            else {
-                assert(layer == MapLayer::BACKGROUND);
-                tiles[index].background = current;
-            }
+            setTileType(index % width, index / width, layer, current);
             ++index;
         }
     }
-    assert(getForeground(0, 0) -> type == tiles[0].foreground);
 }
 
 // Constructor
@@ -537,13 +912,17 @@ Map::Map(string filename, int tileWidth, int tileHeight) :
         TILE_WIDTH(tileWidth), TILE_HEIGHT(tileHeight) {
     /* It's the 0th tick. */
     tick = 0;
+    simulationRadius = SIMULATION_RADIUS;
+    streamed = false;
+    loader = nullptr;
     ifstream infile(filename);
 
     exps.resize(MAX_OPACITY, 0);
 
-    /* Create a tile object for each type. */
+    /* Create a tile object for each type. This map will be played on, so the
+    tiles need their textures. */
     for (int i = 0; i <= (int)TileType::LAST_TILE; i++) {
-        newTile((TileType)i);
+        newTile((TileType)i) -> loadSprite();
     }
 
     /* Check that the file could be opened. */
@@ -575,12 +954,44 @@ Map::Map(string filename, int tileWidth, int tileHeight) :
     infile >> width >> height;
     setWidth(width);
     setHeight(height);
-    tiles = new SpaceInfo[width * height];
-    biomes.resize(biomesWide * biomesHigh);
+    makeChunkTable();
     infile >> spawn.x >> spawn.y;
     infile >> seed;
 
+    /* Maps saved before there were physics fields have earth's gravity
+    everywhere. */
+    gravity = EARTH_GRAVITY;
     infile >> header;
+    if (header == "#Physics") {
+        int changed;
+        infile >> gravity >> changed;
+        for (int i = 0; i < changed; i++) {
+            unsigned int index;
+            PhysicsField field;
+            infile >> index >> field.gravityScale >> field.lift
+                >> field.dragX >> field.dragY;
+            if (!infile || index >= fields.size()) {
+                cerr << "Couldn't load physics fields!\n";
+                break;
+            }
+            fields[index] = field;
+        }
+        infile >> header;
+    }
+
+    if (header == "#Streamed") {
+        /* Only load the chunks around the spawn point for now, and wait
+        for those so the player has somewhere to stand. */
+        streamed = true;
+        overview.resize(width, height);
+        loader = new ChunkLoader(filename + ".chunks", seed, width, height);
+        streamChunks(spawn.x, spawn.y);
+        loader -> wait();
+        streamChunks(spawn.x, spawn.y);
+        return;
+    }
+
+    makeAllChunks();
     if (header != "#Foreground") {
         cerr << "Couldn't load foreground!\n";
     }
@@ -611,7 +1022,9 @@ Map::Map(string filename, int tileWidth, int tileHeight) :
         infile >> count >> biomeInt;
         for (int i = 0; i < count; i++) {
             assert(index < biomesWide * biomesHigh);
-            biomes[index].biome = (BiomeType)biomeInt;
+            BiomeInfo info;
+            info.biome = (BiomeType)biomeInt;
+            setBiome(index % biomesWide, index / biomesWide, info);
             index++;
         }
     }
@@ -626,44 +1039,78 @@ Map::Map(string filename, int tileWidth, int tileHeight) :
     for (int i = 0; i < width * height; i++) {
         int variant;
         infile >> variant;
-        tiles[i].foregroundVariant = (uint8_t)variant;
+        setForegroundVariant(i % width, i / width, (uint8_t)variant);
         infile >> variant;
-        tiles[i].backgroundVariant = (uint8_t)variant;
+        setBackgroundVariant(i % width, i / width, (uint8_t)variant);
     }
 
-    /* Iterate over the entire map. */
-    Location fore;
-    Location back;
-    fore.layer = MapLayer::FOREGROUND;
-    back.layer = MapLayer::BACKGROUND;
-    for (int i = 0; i < width; i++) {
-        fore.x = i;
-        back.x = i;
-        for (int j = 0; j < height; j++) {
-            fore.y = j;
-            back.y = j;
-            /* Add the appropriate tiles to our list of tiles to update. */
-            addToUpdate(fore);
-            addToUpdate(back);
+    /* Loading the foreground filled all the water up, so only maps with
+    water levels saved need to change it. */
+    header.clear();
+    infile >> header;
+    if (header == "#Liquid") {
+        index = 0;
+        int level;
+        while (index < height * width && infile) {
+            infile >> count >> level;
+            for (int i = 0; i < count && index < height * width; i++) {
+                SpaceInfo *space = findPointer(index % width, index / width);
+                if (space -> foreground == TileType::WATER && level != 0) {
+                    space -> liquid = level;
+                }
+                index++;
+            }
         }
     }
+
+    /* Tiles start updating once a player is near them, and get checked
+    then. */
+    buildOverview();
+}
+
+Map::Map(int width, int height, int tileWidth, int tileHeight) :
+        TILE_WIDTH(tileWidth), TILE_HEIGHT(tileHeight) {
+    tick = 0;
+    simulationRadius = SIMULATION_RADIUS;
+    streamed = false;
+    loader = nullptr;
+    seed = 0;
+    spawn = Location(0, 0, MapLayer::FOREGROUND);
+    gravity = EARTH_GRAVITY;
+    exps.resize(MAX_OPACITY, 0);
+
+    for (int i = 0; i <= (int)TileType::LAST_TILE; i++) {
+        newTile((TileType)i);
+    }
+
+    setWidth(width);
+    setHeight(height);
+    makeChunkTable();
+    makeAllChunks();
+    buildOverview();
 }
 
-void Map::savePPM(MapLayer layer, std::string filename) {
-    ofstream outfile(filename + ".ppm");
-    /* Header saying we'll use ASCII, along with the height, width,
-    and maximum value. */
-    outfile << "P3\n" << width << " " << height << "\n255\n";
-    for (int j = height - 1; j >= 0; j--) {
-        for (int i = 0; i < width; i++) {
-            Tile *tile = getTile(i, j, layer);
-            /* Output red, green, and blue values for each tile. */
-            outfile << (int)(tile -> getColor().r) << " ";
-            outfile << (int)(tile -> getColor().g) << " ";
-            outfile << (int)(tile -> getColor().b) << " ";
+void Map::savePPM(MapLayer layer, std::string filename) const {
+    vector<unsigned char> pixels(3 * width * height);
+    /* Rows don't depend on each other, so fill them in at the same time. */
+    parallelFor(height, [&](int start, int stop) {
+        for (int j = start; j < stop; j++) {
+            unsigned char *row = &pixels[3 * width * (height - 1 - j)];
+            for (int i = 0; i < width; i++) {
+                const SpaceInfo *space = peek(i, j);
+                /* Places that aren't loaded are left black. */
+                if (space != nullptr) {
+                    Light color = getTile(layer == MapLayer::FOREGROUND?
+                        space -> foreground : space -> background)
+                        -> getColor();
+                    row[3 * i] = color.r;
+                    row[3 * i + 1] = color.g;
+                    row[3 * i + 2] = color.b;
+                }
+            }
         }
-        outfile << "\n";
-    } 
+    }, ROWS_PER_THREAD);
+    writePPM(filename + ".ppm", width, height, pixels);
 }
 
 
@@ -704,24 +1151,45 @@ Light Map::getBiomeColor(BiomeInfo biome) const {
     return color;
 }
 
-void Map::saveBiomePPM(std::string filename) {
-    ofstream outfile(filename + "_biomes.ppm");
-    /* Header saying we'll use ASCII, along with the height, width,
-    and maximum value. */
-    outfile << "P3\n" << width << " " << height << "\n255\n";
-    for (int j = height - 1; j >= 0; j--) {
-        for (int i = 0; i < width; i++) {
-            Light biomeColor = getBiomeColor(*getBiome(i, j));
-            if (getTileType(i, j, MapLayer::FOREGROUND) == TileType::EMPTY) {
-                biomeColor = biomeColor.times(0.5);
+void Map::saveBiomePPM(std::string filename) const {
+    vector<unsigned char> pixels(3 * width * height);
+    parallelFor(height, [&](int start, int stop) {
+        for (int j = start; j < stop; j++) {
+            unsigned char *row = &pixels[3 * width * (height - 1 - j)];
+            for (int i = 0; i < width; i++) {
+                Chunk *chunk = getChunk(i, j);
+                if (chunk == nullptr) {
+                    continue;
+                }
+                Light biomeColor = getBiomeColor(*chunk -> getBiome(i, j));
+                if (chunk -> getSpace(i, j) -> foreground == TileType::EMPTY) {
+                    biomeColor = biomeColor.times(0.5);
+                }
+                row[3 * i] = biomeColor.r;
+                row[3 * i + 1] = biomeColor.g;
+                row[3 * i + 2] = biomeColor.b;
             }
-            /* Output red, green, and blue values for each tile. */
-            outfile << (int)(biomeColor.r) << " ";
-            outfile << (int)(biomeColor.g) << " ";
-            outfile << (int)(biomeColor.b) << " ";
         }
-        outfile << "\n";
-    } 
+    }, ROWS_PER_THREAD);
+    writePPM(filename + "_biomes.ppm", width, height, pixels);
+}
+
+void Map::saveOverviewPPM(std::string filename, int level) const {
+    assert(0 <= level && level < overview.getLevels());
+    int w = overview.getWidth(level);
+    int h = overview.getHeight(level);
+    vector<unsigned char> pixels(3 * w * h);
+    for (int j = 0; j < h; j++) {
+        unsigned char *row = &pixels[3 * w * (h - 1 - j)];
+        for (int i = 0; i < w; i++) {
+            Light color = overview.getPixel(level, i, j);
+            row[3 * i] = color.r;
+            row[3 * i + 1] = color.g;
+            row[3 * i + 2] = color.b;
+        }
+    }
+    writePPM(filename + "_overview" + to_string(level) + ".ppm", w, h,
+        pixels);
 }
 
 TileType Map::getTileType(int x, int y, MapLayer layer) const {
@@ -737,6 +1205,44 @@ TileType Map::getTileType(int x, int y, MapLayer layer) const {
     }
 }
 
+void Map::applyEdits(vector<TileEdit> &edits) {
+    for (unsigned int i = 0; i < edits.size(); i++) {
+        edits[i].x = wrapX(edits[i].x);
+    }
+    /* Sort by chunk, then the order the tiles are stored in. */
+    sort(edits.begin(), edits.end(), [this](const TileEdit &a,
+            const TileEdit &b) {
+        int aChunk = getChunkIndex(a.x, a.y);
+        int bChunk = getChunkIndex(b.x, b.y);
+        if (aChunk != bChunk) {
+            return aChunk < bChunk;
+        }
+        if (a.y != b.y) {
+            return a.y < b.y;
+        }
+        return a.x < b.x;
+    });
+
+    for (unsigned int i = 0; i < edits.size(); i++) {
+        const TileEdit &edit = edits[i];
+        if (edit.y < 0 || edit.y >= height) {
+            continue;
+        }
+        Chunk *chunk = getChunk(edit.x, edit.y);
+        if (chunk == nullptr) {
+            continue;
+        }
+        SpaceInfo *space = chunk -> getSpace(edit.x, edit.y);
+        if (edit.layer == MapLayer::FOREGROUND) {
+            space -> setForeground(edit.type);
+        }
+        else {
+            assert(edit.layer == MapLayer::BACKGROUND);
+            space -> background = edit.type;
+        }
+    }
+}
+
 void Map::setTile(int x, int y, MapLayer layer, TileType val) {
     assert(layer == MapLayer::FOREGROUND || layer == MapLayer::BACKGROUND
             || layer == MapLayer::NONE);
@@ -744,7 +1250,20 @@ void Map::setTile(int x, int y, MapLayer layer, TileType val) {
     bool wasSky = isSky(x, y);
 
     if (layer == MapLayer::FOREGROUND) {
-        findPointer(x, y) -> foreground = val;
+        /* Water that's already there keeps its level. */
+        SpaceInfo *space = findPointer(x, y);
+        if (val != TileType::WATER || space -> foreground != TileType::WATER) {
+            space -> setForeground(val);
+        }
+        /* The overview only shows the foreground. Its pixels are shared
+        between chunks, so threads leave it for later. */
+        if (batch != nullptr) {
+            batch -> changed.push_back(Location(wrapX(x), y,
+                MapLayer::FOREGROUND));
+        }
+        else if (overview.getLevels() != 0) {
+            refreshOverview(wrapX(x), wrapX(x) + 1, y, y + 1);
+        }
     }
     else if (layer == MapLayer::BACKGROUND) {
         findPointer(x, y) -> background = val;
@@ -790,32 +1309,143 @@ bool Map::placeTile(Location place, TileType type) {
 
     setTile(place, type);
     setVariant(place.x, place.y, place.layer, 
-        getTile(place) -> getInitialVariant());
+        getTile(place) -> getInitialVariant(getTileRandom(place)));
 
     return true;
 }
 
-void Map::update(vector<DroppedItem*> &items) {
-    /* Make sure we're updating tiles that need to be updated. */
-    set<Location>::iterator removeIter = toUpdate.begin();
-    while (removeIter != toUpdate.end()) {
-        if (!(getTile(*removeIter) -> canUpdate(*this, *removeIter))) {
-            removeIter = toUpdate.erase(removeIter);
+void Map::update(SlotMap<DroppedItem> &items) {
+    /* Only chunks near players update, so the cost of a tick depends on
+    how many players there are and not on how big the map is. */
+    updateSimulated(items);
+
+    /* Only the tiles due this tick get looked at. Anything they change
+    schedules the tiles around it, which is how idle tiles get woken up. */
+    vector<Location> due = toUpdate.take(tick);
+    for (unsigned int i = 0; i < due.size(); i++) {
+        int index = getChunkIndex(due[i].x, due[i].y);
+        assert(activeTiles[index] > 0);
+        activeTiles[index]--;
+    }
+
+    /* Go a chunk at a time, bottom row of chunks first, and bottom up
+    within each chunk. That way a falling tile always gets out of the way
+    before whatever is on top of it tries to move, and the order never
+    depends on anything but where the tiles are. */
+    sort(due.begin(), due.end(), [this](const Location &a,
+            const Location &b) {
+        int aChunk = getChunkIndex(a.x, a.y);
+        int bChunk = getChunkIndex(b.x, b.y);
+        if (aChunk != bChunk) {
+            return aChunk < bChunk;
         }
-        else {
-            ++removeIter;
+        if (a.y != b.y) {
+            return a.y < b.y;
+        }
+        if (a.x != b.x) {
+            return a.x < b.x;
         }
+        return (int)a.layer < (int)b.layer;
+    });
+
+    /* Split them up by chunk. */
+    vector<TileUpdateBatch> batches;
+    for (unsigned int i = 0; i < due.size(); i++) {
+        int index = getChunkIndex(due[i].x, due[i].y);
+        if (batches.empty() || batches.back().chunk != index) {
+            batches.emplace_back();
+            batches.back().chunk = index;
+            batches.back().begin = i;
+            batches.back().counters = TileProfile::makeCounters();
+        }
+        batches.back().end = i + 1;
     }
 
-    /* Iterate over a copy of the list. */
-    set<Location> newUpdate = toUpdate;
-    set<Location>::iterator iter = newUpdate.begin();
-    while (iter != newUpdate.end()) {
-        Tile *tile = getTile(*iter);
-        tile -> update(*this, *iter, items, tick);
-        iter++;
+    /* A tile update can reach into the chunks around it, but the chunks
+    updated at once are never next to each other, so nothing here races.
+    Anything it does to the rest of the map goes in its chunk's batch. */
+    vector<TileUpdateBatch *> jobs;
+    auto run = [&](int start, int stop) {
+        for (int j = start; j < stop; j++) {
+            batch = jobs[j];
+            for (int i = batch -> begin; i < batch -> end; i++) {
+                Tile *tile = getTile(due[i]);
+                TileCounters &counters = batch -> counters[(int)tile
+                    -> type];
+                /* It might have changed since it was scheduled. */
+                if (!tile -> canUpdate(*this, due[i])) {
+                    counters.rejected++;
+                    continue;
+                }
+                chrono::steady_clock::time_point start
+                    = chrono::steady_clock::now();
+                bool again = tile -> update(*this, due[i], items, tick);
+                counters.nanoseconds += chrono::duration_cast<
+                    chrono::nanoseconds>(chrono::steady_clock::now()
+                    - start).count();
+                counters.updates++;
+                if (again) {
+                    batch -> wake.push_back(due[i]);
+                }
+            }
+            batch = nullptr;
+        }
+    };
+
+    /* Finish each row of chunks before starting the one above it, so the
+    order stays bottom up across the edges between rows too. Only chunks in
+    the same row run at the same time. */
+    unsigned int rowStart = 0;
+    while (rowStart < batches.size()) {
+        int row = batches[rowStart].chunk / chunksWide;
+        unsigned int rowEnd = rowStart;
+        while (rowEnd < batches.size()
+                && batches[rowEnd].chunk / chunksWide == row) {
+            rowEnd++;
+        }
+
+        for (int phase = 0; phase < CHUNK_PHASES; phase++) {
+            jobs.clear();
+            int tiles = 0;
+            for (unsigned int i = rowStart; i < rowEnd; i++) {
+                if (getChunkPhase(batches[i].chunk) == phase) {
+                    jobs.push_back(&batches[i]);
+                    tiles += batches[i].end - batches[i].begin;
+                }
+            }
+            if (tiles >= PARALLEL_TILE_UPDATES) {
+                parallelFor(jobs.size(), run);
+            }
+            else {
+                run(0, jobs.size());
+            }
+
+            /* Catch up on what they saved, in the same order every time. */
+            for (unsigned int j = 0; j < jobs.size(); j++) {
+                const TileUpdateBatch &done = *jobs[j];
+                profile.add(done.counters);
+                drops.insert(drops.end(), done.drops.begin(),
+                    done.drops.end());
+                for (unsigned int i = 0; i < done.changed.size()
+                        && overview.getLevels() != 0; i++) {
+                    int x = done.changed[i].x;
+                    int y = done.changed[i].y;
+                    refreshOverview(x, x + 1, y, y + 1);
+                }
+                for (unsigned int i = 0; i < done.wake.size(); i++) {
+                    addToUpdate(done.wake[i]);
+                }
+            }
+        }
+        rowStart = rowEnd;
     }
 
+    /* Water flows after the tiles have moved, on this thread. */
+    liquids.update(*this, tick, items);
+
+    /* Then a few random tiles in each chunk get a chance to change. */
+    randomTicks.update(*this);
+
     /* Heal tiles that have been damaged for a while. */
     /* Tiles stay damaged for this many ticks, with about 20-40 ticks/sec. */
     const int healTime = 3000;
@@ -830,11 +1460,15 @@ void Map::update(vector<DroppedItem*> &items) {
         }
     }
 
+    /* Everything destroyed this tick turns into items together. */
+    spawnDrops(items);
+
     /* It's a new tick. */
+    profile.endTick();
     tick++;
 }
 
-bool Map::damage(Location place, int amount, vector<DroppedItem*> &items) {
+bool Map::damage(Location place, int amount, SlotMap<DroppedItem> &items) {
     /* If there's no tile here, just return false. */
     if (getTile(place) -> type == TileType::EMPTY
         || getTile(place) -> type == TileType::WATER) {
@@ -865,25 +1499,90 @@ bool Map::damage(Location place, int amount, vector<DroppedItem*> &items) {
     if (destroy(damaged[index], items)) {
         /* If it was destroyed, removed it from the list. */
         damaged.erase(damaged.begin() + index);
+        spawnDrops(items);
     }
 
     return true;
 }
 
-void Map::kill(int x, int y, MapLayer layer, vector<DroppedItem*> &items) {
+void Map::kill(int x, int y, MapLayer layer, SlotMap<DroppedItem> &items) {
     // Drop itself as an item
     TileType type = getTileType(wrapX(x), y, layer);
-    assert(type != TileType::WATER);
-    if (type != TileType::EMPTY) {
-        items.push_back(new DroppedItem ((ItemMaker::makeItem(
-            ItemMaker::tileToItem(type))), 
-            x * TILE_WIDTH, y * TILE_HEIGHT, width * TILE_WIDTH));
+    /* Water just goes away. */
+    if (type != TileType::EMPTY && type != TileType::WATER) {
+        dropItem(type, x, y);
     }
 
     // Set the place it used to be to empty
     setTile(x, y, layer, TileType::EMPTY);
 }
 
+void Map::dropItem(TileType type, int x, int y) {
+    /* Batches get added on in chunk order, so the drops end up in the same
+    order no matter how the threads ran. */
+    if (batch != nullptr) {
+        batch -> drops.push_back({x, y, MapLayer::NONE, type});
+        return;
+    }
+    drops.push_back({x, y, MapLayer::NONE, type});
+}
+
+void Map::spawnDrops(SlotMap<DroppedItem> &items) {
+    /* Sort them so that drops that go in the same stack are together. */
+    for (unsigned int i = 0; i < drops.size(); i++) {
+        drops[i].x = wrapX(drops[i].x);
+    }
+    auto sameStack = [](const TileEdit &a, const TileEdit &b) {
+        return a.type == b.type
+            && a.x / DROP_STACK_SIZE == b.x / DROP_STACK_SIZE
+            && a.y / DROP_STACK_SIZE == b.y / DROP_STACK_SIZE;
+    };
+    stable_sort(drops.begin(), drops.end(), [](const TileEdit &a,
+            const TileEdit &b) {
+        if (a.type != b.type) {
+            return a.type < b.type;
+        }
+        if (a.x / DROP_STACK_SIZE != b.x / DROP_STACK_SIZE) {
+            return a.x / DROP_STACK_SIZE < b.x / DROP_STACK_SIZE;
+        }
+        return a.y / DROP_STACK_SIZE < b.y / DROP_STACK_SIZE;
+    });
+
+    unsigned int start = 0;
+    while (start < drops.size()) {
+        unsigned int end = start + 1;
+        while (end < drops.size() && sameStack(drops[start], drops[end])) {
+            end++;
+        }
+
+        /* Put the stack where the first of them was. It only needs
+        splitting if there's more than fits in one stack. */
+        const TileEdit &first = drops[start];
+        int count = end - start;
+        while (count > 0) {
+            Item *item = ItemMaker::makeItem(ItemMaker::tileToItem(
+                first.type));
+            int stack = min(count, item -> getMaxStack());
+            item -> setStack(stack);
+            count -= stack;
+            items.insert(new DroppedItem(item, first.x * TILE_WIDTH,
+                first.y * TILE_HEIGHT, width * TILE_WIDTH));
+        }
+        start = end;
+    }
+    drops.clear();
+}
+
+RandomStream Map::getRandom(const Location &place) const {
+    return RandomStream((unsigned int)seed, tick, (unsigned int)place.x,
+        (unsigned int)place.y, (unsigned int)place.layer);
+}
+
+RandomStream Map::getRandom(unsigned int id) const {
+    /* No place has a y this big, so these never share a key with a tile. */
+    return RandomStream((unsigned int)seed, tick, id, ~(uint64_t)0);
+}
+
 Location Map::getMapCoords(int x, int y, MapLayer layer) {
     assert(layer == MapLayer::FOREGROUND || layer == MapLayer::BACKGROUND
             || layer == MapLayer::NONE);
@@ -913,7 +1612,7 @@ Location Map::getMapCoords(int x, int y, MapLayer layer) {
 }
 
 void Map::moveTile(const Location &place, int x, int y, 
-        vector<DroppedItem*> &items) {
+        SlotMap<DroppedItem> &items) {
     assert(place.x >= 0);
     assert(place.x < width);
     assert(place.y >=0);
@@ -928,6 +1627,7 @@ void Map::moveTile(const Location &place, int x, int y,
 
     kill(newX, place.y + y, place.layer, items);
     TileType val = getTileType(place, 0, 0);
+    countMove(val);
     uint8_t variant = getVariant(place.x, place.y, place.layer);
     setVariant(newX, place.y + y, place.layer, variant);
     setTile(newX, place.y + y, place.layer, val);
@@ -943,11 +1643,19 @@ void Map::displaceTile(const Location &place, int x, int y) {
     }
 
     TileType destination = getTileType(place, x, y);
+    countMove(getTile(place) -> type);
     uint8_t oldVariant = getVariant(place.x, place.y, place.layer);
     uint8_t newVariant = getVariant(newX, place.y + y, place.layer);
     setVariant(place.x, place.y, place.layer, newVariant);
     setVariant(newX, place.y + y, place.layer, oldVariant);
+    /* Water keeps its level when it trades places. */
+    uint8_t oldLiquid = findPointer(place.x, place.y) -> liquid;
+    uint8_t newLiquid = findPointer(newX, place.y + y) -> liquid;
     setTile(newX, place.y + y, place.layer, getTile(place) -> type);
     setTile(place, destination);
+    if (place.layer == MapLayer::FOREGROUND) {
+        findPointer(place.x, place.y) -> liquid = newLiquid;
+        findPointer(newX, place.y + y) -> liquid = oldLiquid;
+    }
 }
 
@@ -7,20 +7,81 @@
 #include <algorithm>
 #include "Tile.hh"
 #include "MapHelpers.hh"
+#include "Chunk.hh"
+#include "MapOverview.hh"
+#include "TickWheel.hh"
+#include "LiquidFlow.hh"
+#include "RandomTicks.hh"
+#include "TileProfile.hh"
+#include "PhysicsField.hh"
+#include "../util/Random.hh"
+#include "../util/SlotMap.hh"
 
 #define MAX_OPACITY 64
 
 class DroppedItem;
+class ChunkLoader;
+
+/* For streamed maps, chunks this many chunks away from the player (in both
+directions) are loaded, and chunks further than the unload radius are saved
+and taken out of memory. The gap between them keeps chunks at the edge from
+being loaded and unloaded over and over. */
+#define CHUNK_LOAD_RADIUS 3
+#define CHUNK_UNLOAD_RADIUS 5
+
+/* By default, tiles in chunks this many chunks away from a player (in both
+directions) are updated. Everything further away is frozen until a player
+comes back. */
+#define SIMULATION_RADIUS 2
+
+/* Chunks with tiles to update go a row at a time, bottom row first, and each
+row is split into this many groups, so that no two chunks in a group are next
+to each other, and each group is updated on as many threads as there are
+cores. There's a group for even columns and one for odd columns, plus one for
+the last column when the map is an odd number of chunks wide, since it's next
+to the first column. */
+#define CHUNK_PHASES 3
+
+/* Only bother starting threads when at least this many tiles are due in a
+group. */
+#define PARALLEL_TILE_UPDATES 512
+
+/* Tiles of the same type destroyed within a square this many tiles across
+in the same tick drop as one stack. */
+#define DROP_STACK_SIZE 4
+
+/* What the tile updates in one chunk want done to the rest of the map. While
+chunks update on several threads, these get saved up and done afterwards, a
+chunk at a time, so the result doesn't depend on how the threads ran. */
+struct TileUpdateBatch {
+    int chunk;
+
+    /* Which of the tiles due this tick are in the chunk. */
+    int begin;
+    int end;
+
+    /* Tiles to schedule. */
+    std::vector<Location> wake;
+
+    /* Foreground tiles that changed, for the overview. */
+    std::vector<Location> changed;
+
+    /* Tiles to drop as items. */
+    std::vector<TileEdit> drops;
+
+    /* What the tiles in the chunk cost, for the profile. */
+    std::vector<TileCounters> counters;
+};
 
-/* In the biome information stored, each piee refers to a square this size of
-tiles. */
-#define BIOME_SIZE 32
-
-/* A class for a map. Holds an array of SpaceInfos, which store the foreground
-and background tiles, among other things. */
+/* A class for a map. Holds chunks of SpaceInfos, which store the foreground
+and background tiles, among other things. A map can either keep every chunk
+in memory, or be streamed, where chunks are generated the first time they're
+needed and saved and unloaded once they're far away. */
 class Map {
     /* Mapgen is basically an extra-fancy constructor. */
     friend class Mapgen;
+    friend class LiquidFlow;
+    friend class RandomTicks;
 
     const int TILE_WIDTH;
     const int TILE_HEIGHT;
@@ -31,11 +92,35 @@ class Map {
     /* How many ticks since the map was loaded. */
     unsigned int tick;
 
-    /* The array to hold the map info. This is a 2d array squished into 1d. */
-    SpaceInfo *tiles;
+    /* The map info, in chunks. This is a 2d array squished into 1d, with
+    nullptr for chunks that aren't in memory. */
+    std::vector<Chunk *> chunks;
+
+    /* The height and width of the chunk array. */
+    int chunksHigh, chunksWide;
+
+    /* Whether the map is streamed instead of all in memory. */
+    bool streamed;
+
+    /* For streamed maps, what loads and saves chunks. Otherwise nullptr. */
+    ChunkLoader *loader;
+
+    /* Which chunks are in memory and which ones have been asked for, for
+    streamed maps. */
+    std::set<int> loadedChunks;
+    std::set<int> requestedChunks;
+
+    /* Stand-ins for places whose chunk isn't in memory. They're reset every
+    time they're used, so anything written to them is thrown away. */
+    static thread_local SpaceInfo unloadedSpace;
+    mutable BiomeInfo unloadedBiome;
 
-    /* The array to hold the biome info. */
-    std::vector<BiomeInfo> biomes;
+    /* What the chunk this thread is updating has saved up, or nullptr when
+    tiles aren't being updated in parallel. */
+    static thread_local TileUpdateBatch *batch;
+
+    /* Small pictures of the whole map, kept up to date as tiles change. */
+    MapOverview overview;
 
     /* A list of Tiles. They contain memory that must be manually garbage
     collected because of the SDL textures. */
@@ -51,23 +136,168 @@ class Map {
     spawn points later. */
     Location spawn;
 
-    /* The tiles whose update function should be called. */
-    std::set<Location> toUpdate;
+    /* How much gravity changes the y velocity each tick, before any field
+    changes it. */
+    double gravity;
+
+    /* The physics field of each chunk, in the same order as the chunk table.
+    These are kept for chunks that aren't in memory, so looking one up never
+    has to wait for a chunk. */
+    std::vector<PhysicsField> fields;
+
+    /* The tiles whose update function should be called, and on which
+    tick. */
+    TickWheel toUpdate;
+
+    /* How many tiles in each chunk are in toUpdate. Chunks with none are
+    asleep and cost nothing until something next to them changes. */
+    std::vector<int> activeTiles;
+
+    /* Where water is flowing. */
+    LiquidFlow liquids;
+
+    /* Slow changes that happen to random tiles. */
+    RandomTicks randomTicks;
+
+    /* What each type of tile costs to update. */
+    TileProfile profile;
+
+    /* Count a tile of that type moving, in whichever counts this thread
+    should use. */
+    inline void countMove(TileType type) {
+        if (batch != nullptr) {
+            batch -> counters[(int)type].moves++;
+        }
+        else {
+            profile.count(type).moves++;
+        }
+    }
+
+    /* How many chunks away from a player tiles still get updated. */
+    int simulationRadius;
+
+    /* The chunks that were near a player last tick, and whether each chunk
+    is one of them. Only these have anything in toUpdate or liquids. */
+    std::vector<int> simulatedChunks;
+    std::vector<bool> isSimulated;
+
+    /* Which tick each chunk stopped being simulated on. */
+    std::vector<unsigned int> frozenSince;
+
+    /* The chunks players asked to simulate this tick, by simulateNear. */
+    std::set<int> nearPlayers;
 
     /* Tiles that have been damaged. */
     std::vector<TileHealth> damaged;
 
+    /* Tiles destroyed since items were last made for them. */
+    std::vector<TileEdit> drops;
+
     /* Table of pre-calculated exponentials. */
     std::vector<double> exps;
 
+    /* Return the index of the chunk x, y is in. x and y must be on the
+    map. */
+    inline int getChunkIndex(int x, int y) const {
+        return (y >> CHUNK_SHIFT) * chunksWide + (x >> CHUNK_SHIFT);
+    }
+
+    /* Which group of chunks in its row the chunk updates with. */
+    inline int getChunkPhase(int index) const {
+        int x = index % chunksWide;
+        if (chunksWide % 2 == 1 && chunksWide > 1 && x == chunksWide - 1) {
+            return 2;
+        }
+        return x % 2;
+    }
+
+    /* Save a destroyed tile to drop as an item once the tick is over. If
+    this is one of several threads updating tiles, the batch saves it. */
+    void dropItem(TileType type, int x, int y);
+
+    /* Make items for the tiles destroyed since last time. Making an item
+    means reading its json and loading its texture, so drops close together
+    share a stack instead of each making their own. */
+    void spawnDrops(SlotMap<DroppedItem> &items);
+
+    /* Have the liquid at x, y flow next tick. Places off the top or bottom of
+    the map or in chunks that aren't simulated are ignored. */
+    inline void wakeLiquid(int x, int y) {
+        if (y < 0 || y >= height) {
+            return;
+        }
+        x = wrapX(x);
+        int index = getChunkIndex(x, y);
+        if (isSimulated[index]) {
+            liquids.wake(index, x, y);
+        }
+    }
+
+    /* Stop updating the tiles in a chunk, and remember when. */
+    void freeze(int index);
+
+    /* Start updating the tiles in a chunk again. Anything that would have
+    fallen while it was frozen falls all at once, then every tile in it gets
+    rechecked. */
+    void thaw(int index, SlotMap<DroppedItem> &items);
+
+    /* Freeze and thaw chunks so the simulated ones are the ones players
+    asked for this tick. */
+    void updateSimulated(SlotMap<DroppedItem> &items);
+
+    /* Return the chunk x, y is in, or nullptr if it isn't loaded. x and y
+    must be on the map. */
+    inline Chunk *getChunk(int x, int y) const {
+        return chunks[getChunkIndex(x, y)];
+    }
+
     /* Return a pointer to the SpaceInfo* at x, y. */
     inline SpaceInfo *findPointer(int x, int y) const {
         x = wrapX(x);
         assert (0 <= y);
         assert (y < height);
-        return tiles + (y * width + x);
+        Chunk *chunk = getChunk(x, y);
+        if (chunk == nullptr) {
+            return getUnloaded();
+        }
+        return chunk -> getSpace(x, y);
     }
 
+    /* Return the SpaceInfo at x, y, or nullptr if it isn't loaded. This
+    never touches the stand-in, so several threads can call it at once. */
+    inline const SpaceInfo *peek(int x, int y) const {
+        assert(isOnMap(x, y));
+        Chunk *chunk = getChunk(x, y);
+        return chunk == nullptr? nullptr : chunk -> getSpace(x, y);
+    }
+
+    /* Recalculate the overview for a rectangle of tiles, including left and
+    bottom but not right and top. */
+    void refreshOverview(int left, int right, int bottom, int top);
+
+    /* Start the overview over and calculate all of it. */
+    void buildOverview();
+
+    /* Return the stand-in for a tile whose chunk isn't loaded. It's solid
+    stone, so nothing can fall into a chunk before it exists. */
+    SpaceInfo *getUnloaded() const;
+
+    /* Make the chunk table fit the width and height, with no chunks in it. */
+    void makeChunkTable();
+
+    /* Make every chunk, for maps that are always entirely in memory. */
+    void makeAllChunks();
+
+    /* Put a chunk that finished loading into the map. */
+    void addChunk(int index, Chunk *chunk);
+
+    /* Take a chunk out of the map and give it to the loader to save. */
+    void removeChunk(int index);
+
+    /* How many chunks away the chunk at index is from chunkX, chunkY, in
+    whichever direction is further. This counts wrapping around. */
+    int chunkDistance(int index, int chunkX, int chunkY) const;
+
     /* Make a Tile object (or one of its subclasses), add it to the list of 
     pointers, and return a pointer to it. */
     Tile *newTile(TileType val);
@@ -125,10 +355,14 @@ private:
     inline BiomeInfo *getBiome(int x, int y) {
         assert(0 <= x);
         assert(0 <= y);
-        assert(x < biomesWide * BIOME_SIZE);
-        assert(y < biomesHigh * BIOME_SIZE);
-        int index = biomesWide * (y / BIOME_SIZE) + (x / BIOME_SIZE); 
-        return &biomes[index];
+        assert(x < width);
+        assert(y < height);
+        Chunk *chunk = getChunk(x, y);
+        if (chunk == nullptr) {
+            unloadedBiome.biome = BiomeType::GRASSLAND;
+            return &unloadedBiome;
+        }
+        return chunk -> getBiome(x, y);
     }
 
     /* Set the biomeInfo at x, y of the biomes vector (which is different than
@@ -141,8 +375,11 @@ private:
         assert(0 <= y);
         assert(x < biomesWide);
         assert(y < biomesHigh);
-        int index = biomesWide * y + x;
-        biomes[index] = info;
+        /* The biome array is a little bigger than the map, and nothing is
+        kept for the part that's off the edge. */
+        if (isOnMap(x * BIOME_SIZE, y * BIOME_SIZE)) {
+            *getBiome(x * BIOME_SIZE, y * BIOME_SIZE) = info;
+        }
     }
 
     public:
@@ -153,9 +390,25 @@ private:
         assert(place.x < width);
         assert(0 <= place.y);
         assert(place.y < height);
+        /* While chunks update in parallel, this gets done afterwards. */
+        if (batch != nullptr) {
+            batch -> wake.push_back(place);
+            return;
+        }
+        if (place.layer == MapLayer::LIQUID) {
+            wakeLiquid(place.x, place.y);
+            return;
+        }
+        /* Frozen chunks get everything rechecked when they thaw. */
+        int index = getChunkIndex(place.x, place.y);
+        if (!isSimulated[index]) {
+            return;
+        }
         /* Ignore it if it won't need to be updated. */
-        if (getTile(place) -> canUpdate(*this, place)) {
-            toUpdate.insert(place);
+        Tile *tile = getTile(place);
+        if (tile -> canUpdate(*this, place) && toUpdate.schedule(place,
+                tick + tile -> getUpdateDelay(tick))) {
+            activeTiles[index]++;
         }
     }
 
@@ -168,7 +421,10 @@ private:
     }
 
     inline void removeFromUpdate(const Location &place) {
-        toUpdate.erase(place);
+        assert(batch == nullptr);
+        if (toUpdate.cancel(place)) {
+            activeTiles[getChunkIndex(place.x, place.y)]--;
+        }
     }
 
     inline void removeFromUpdate(int x, int y, MapLayer layer) {
@@ -180,7 +436,7 @@ private:
     }
 
     inline bool updateContains(const Location &place) const {
-        return toUpdate.count(place);
+        return toUpdate.contains(place);
     }
 
     /* Calculates the coefficent for light when the opacity is n. */
@@ -211,24 +467,43 @@ private:
     /* Save the map to a file. */
     void save(std::string filename) const;
 
+    /* Save how full of water each tile is. */
+    void saveLiquid(std::ofstream &outfile) const;
+
     /* Read the foreground or background layer in from the savefile. */
     void loadLayer(MapLayer layer, std::ifstream &infile);
 
     /* Constructor, from a savefile. */
     Map(std::string filename, int tileWidth, int tileHeight);
 
+    /* Make a map with nothing in it, for trying things out on, like in
+    tests. The tiles don't get textures, so it can't be drawn. */
+    Map(int width, int height, int tileWidth, int tileHeight);
+
     /* Save the specified layer to a PPM file. */
-    void savePPM(MapLayer layer, std::string filename);
+    void savePPM(MapLayer layer, std::string filename) const;
 
     /* Return a color representing that biome. */
     Light getBiomeColor(BiomeInfo biome) const;
 
     /* Save a picture showing where all the biomes are. */
-    void saveBiomePPM(std::string filename);
+    void saveBiomePPM(std::string filename) const;
+
+    /* Save one level of the overview to a PPM file. */
+    void saveOverviewPPM(std::string filename, int level) const;
+
+    /* Return pictures of the map at several scales, for map views. */
+    inline const MapOverview &getOverview() const {
+        return overview;
+    }
 private:
     // Constructor. Resulting map cannot be played but can be saved.
     inline Map() : TILE_WIDTH(1), TILE_HEIGHT(1) {
-        tiles = nullptr;
+        tick = 0;
+        simulationRadius = SIMULATION_RADIUS;
+        gravity = EARTH_GRAVITY;
+        streamed = false;
+        loader = nullptr;
 
         /* Create a tile object for each type. */
         for (int i = 0; i <= (int)TileType::LAST_TILE; i++) {
@@ -238,15 +513,7 @@ private:
 
 public:
     /* Destructor */
-    inline ~Map() {
-        /* Delete the map. */
-        delete[] tiles;
-        /* Delete each tile object. */
-        while (pointers.empty() == false) {
-            delete pointers.back();
-            pointers.pop_back();
-        }
-    }
+    ~Map();
 
     /* Return the height of the map, in number of tiles. */
     inline int getHeight() const {
@@ -268,11 +535,38 @@ public:
         return TILE_WIDTH;
     }
 
+    /* Return how many ticks since the map was loaded. */
+    inline unsigned int getTick() const {
+        return tick;
+    }
+
     /* Return the default spawn point. */
     inline Location getSpawn() const {
         return spawn;
     }
 
+    /* Return the world's gravity, before any field changes it. */
+    inline double getGravity() const {
+        return gravity;
+    }
+
+    /* Return the physics field of the chunk that has the tile at x, y. Places
+    above or below the map use the nearest chunk. */
+    inline const PhysicsField &getField(int x, int y) const {
+        y = std::min(std::max(y, 0), height - 1);
+        return fields[getChunkIndex(wrapX(x), y)];
+    }
+
+    /* Change the physics field of the chunk chunkX, chunkY, for things like
+    low gravity zones and updrafts. */
+    void setField(int chunkX, int chunkY, const PhysicsField &field);
+
+    /* Put together what something at tile x, y feels this tick: the world's
+    gravity changed by the chunk's field, and the field's drag and the drag
+    of any water there. This looks at one tile, so it's cheap to do once for
+    each movable each tick. */
+    PhysicsSample getPhysics(int x, int y) const;
+
     /* Get the tile variant. */
     inline uint8_t getVariant(int x, int y, MapLayer layer) const {
         if (layer == MapLayer::FOREGROUND) {
@@ -311,6 +605,11 @@ public:
         findPointer(x, y) -> backgroundVariant = val;
     }
 
+    /* Return how much water is at x, y, up to LIQUID_FULL. */
+    inline uint8_t getLiquid(int x, int y) const {
+        return findPointer(x, y) -> liquid;
+    }
+
     /* Return the lighting of a tile. */
     inline Light getLight(int x, int y) const {
         /* Combine the value from blocks with the value from the sky, taking into
@@ -357,7 +656,7 @@ public:
     around it). */
     inline void setTileType(int x, int y, MapLayer layer, TileType type) {
         if (layer == MapLayer::FOREGROUND) {
-            findPointer(x, y) -> foreground = type;
+            findPointer(x, y) -> setForeground(type);
         }
         else {
             assert(layer == MapLayer::BACKGROUND);
@@ -365,6 +664,12 @@ public:
         }
     }
 
+    /* Make a lot of changes at once, for world generation. The edits get
+    sorted so each chunk is only visited once, and like setTileType, nothing
+    else is updated. Edits to chunks that aren't loaded or places off the top
+    or bottom of the map are skipped. */
+    void applyEdits(std::vector<TileEdit> &edits);
+
     /* Get the type of the tile at place.x + x, place.y + y, place.layer. 
     If the tile isn't on the map, return TileType::EMPTY. */
     inline TileType getTileType(const Location &place, int x, int y) const {
@@ -382,17 +687,109 @@ public:
     /* Place a tile in the correct layer. Return whether it was successful. */
     bool placeTile(Location place, TileType type);
 
-    /* Update the map. */
-    void update(std::vector<DroppedItem*> &items);
+    /* Have the chunks within the simulation radius of tile x, y update next
+    tick. This needs calling for each player before every update, and chunks
+    no player is near stay frozen. */
+    void simulateNear(int x, int y);
+
+    inline const std::string &getTileName(TileType type) const {
+        return getTile(type) -> name;
+    }
+
+    /* Whether a type of tile stops things that run into it. */
+    inline bool isSolid(TileType type) const {
+        return getTile(type) -> getIsSolid();
+    }
+
+    /* Whether a type of tile stops things falling onto it. */
+    inline bool isPlatform(TileType type) const {
+        return getTile(type) -> getIsPlatform();
+    }
+
+    /* Whether a type of tile hurts things that overlap it. */
+    inline bool dealsOverlapDamage(TileType type) const {
+        return getTile(type) -> getDealsOverlapDamage();
+    }
+
+    /* Copy the foreground of count tiles, starting at x, y and going right,
+    into out. This wraps around the edge of the map, and tiles in chunks
+    that aren't in memory come out as stone, the same as findPointer. It goes
+    a chunk at a time instead of looking up each tile's chunk. */
+    inline void getForegroundRow(int x, int y, int count,
+            TileType *out) const {
+        assert(0 <= y && y < height);
+        x = wrapX(x);
+        while (count > 0) {
+            int run = std::min(std::min(count, CHUNK_SIZE - (x & CHUNK_MASK)),
+                width - x);
+            Chunk *chunk = getChunk(x, y);
+            if (chunk == nullptr) {
+                std::fill(out, out + run, TileType::STONE);
+            }
+            else {
+                const SpaceInfo *space = chunk -> getSpace(x, y);
+                for (int i = 0; i < run; i++) {
+                    out[i] = space[i].foreground;
+                }
+            }
+            out += run;
+            count -= run;
+            x = wrapX(x + run);
+        }
+    }
+
+    inline const TileProfile &getProfile() const {
+        return profile;
+    }
+
+    /* Write what each type of tile cost over the whole game to a csv
+    file. */
+    inline bool saveProfile(const std::string &filename) const {
+        return profile.save(filename, *this);
+    }
+
+    /* How many chunks away from a player tiles get updated. */
+    inline int getSimulationRadius() const {
+        return simulationRadius;
+    }
+
+    inline void setSimulationRadius(int radius) {
+        assert(radius >= 0);
+        simulationRadius = radius;
+    }
+
+    /* Update the map. Tiles in chunks that aren't next to each other are
+    updated at the same time on different threads, then water flows. Only
+    chunks near players are updated. */
+    void update(SlotMap<DroppedItem> &items);
+
+    /* Random numbers that only depend on the seed, the tick, and the place,
+    for tile updates, which can't use rand() since they run on several threads
+    and have to come out the same every time. */
+    RandomStream getRandom(const Location &place) const;
+
+    /* The same, but for a movable, so each one gets its own numbers every
+    tick. */
+    RandomStream getRandom(unsigned int id) const;
+
+    /* The first number from the place's stream. */
+    inline unsigned int getTileRandom(const Location &place) const {
+        return (unsigned int)getRandom(place).next();
+    }
+
+    /* For streamed maps, ask for the chunks near tile x, y to be loaded, put
+    chunks that finished loading into the map, and send far away chunks off to
+    be saved. Maps that are entirely in memory ignore this. */
+    void streamChunks(int x, int y);
 
     /* Damage a tile (with a pickax or something). Return false if there
     was no tile to damage. */
-    bool damage(Location place, int amount, std::vector<DroppedItem*> &items);
+    bool damage(Location place, int amount, SlotMap<DroppedItem> &items);
 
     /* Destroy a tile if it has no health. Return true if it was destroyed, or
     false if it still had health and lived. */
     inline bool destroy(const TileHealth &health, 
-            std::vector<DroppedItem*> &items) {
+            SlotMap<DroppedItem> &items) {
         if (health.health <= 0) {
             kill(health.place, items);
         }
@@ -400,9 +797,10 @@ public:
         return health.health <= 0;
     }
 
-    /* Destroy a tile. */
-    void kill(int x, int y, MapLayer layer, std::vector<DroppedItem*> &items);
-    inline void kill(const Location &place, std::vector<DroppedItem*> &items) {
+    /* Destroy a tile. The item it drops shows up once the update or damage
+    call that destroyed it is over. */
+    void kill(int x, int y, MapLayer layer, SlotMap<DroppedItem> &items);
+    inline void kill(const Location &place, SlotMap<DroppedItem> &items) {
         kill(place.x, place.y, place.layer, items);
     }
 
@@ -427,7 +825,7 @@ public:
     /* Move a tile x in the +x direction and y in the +y directoin. If there's 
     a tile at the destination, it will be destroyed. */
     void moveTile(const Location &place, int x, int y,
-        std::vector<DroppedItem*> &items);
+        SlotMap<DroppedItem> &items);
 
     /* Move a tile x in the +x direction and y in the +y direction. If there's 
     a tile there, they switch places. */
@@ -91,11 +91,18 @@ enum class Surroundings {
     REANIMATING
 };
 
+/* In the biome information stored, each piece refers to a square this size of
+tiles. */
+#define BIOME_SIZE 32
+
 /* A struct to store information about the biome. */
 struct BiomeInfo {
     BiomeType biome;
 };
 
+/* How much liquid a completely full tile holds. */
+#define LIQUID_FULL 255
+
 /* A struct that holds information about a specific tile location on the map.
 It has pointers to the foreground object (blocks, furniture, trees), the 
 background object (walls), and the liquid. It also has ints for the health of
@@ -119,6 +126,9 @@ struct SpaceInfo {
     uint8_t foregroundVariant;
     uint8_t backgroundVariant;
 
+    // How much liquid is here, up to LIQUID_FULL. Only water has any.
+    uint8_t liquid;
+
     // Constructor
     SpaceInfo() {
         foreground = TileType::EMPTY;
@@ -128,9 +138,25 @@ struct SpaceInfo {
         lightAdded = false;
         foregroundVariant = 0;
         backgroundVariant = 0;
+        liquid = 0;
+    }
+
+    /* Set the foreground tile. New water is full, and anything that isn't
+    water has no liquid. */
+    inline void setForeground(TileType type) {
+        foreground = type;
+        liquid = type == TileType::WATER? LIQUID_FULL : 0;
     }
 };
 
+/* A change to make to one tile, for changing lots of tiles at once. */
+struct TileEdit {
+    int x;
+    int y;
+    MapLayer layer;
+    TileType type;
+};
+
 
 
 #endif
@@ -0,0 +1,70 @@
+#include "MapOverview.hh"
+
+using namespace std;
+
+void MapOverview::resize(int mapWidth, int mapHeight) {
+    shift = OVERVIEW_MIN_SHIFT;
+    while (((long)mapWidth >> shift) * ((long)mapHeight >> shift)
+            > OVERVIEW_MAX_PIXELS) {
+        shift++;
+    }
+
+    widths.clear();
+    heights.clear();
+    levels.clear();
+    int w = max(1, (mapWidth + (1 << shift) - 1) >> shift);
+    int h = max(1, (mapHeight + (1 << shift) - 1) >> shift);
+    while (true) {
+        widths.push_back(w);
+        heights.push_back(h);
+        levels.emplace_back(w * h, Light(0, 0, 0, 0));
+        if (w == 1 && h == 1) {
+            break;
+        }
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+    }
+}
+
+void MapOverview::average(int level, int x, int y) {
+    assert(level > 0);
+    int r = 0;
+    int g = 0;
+    int b = 0;
+    int known = 0;
+    for (int j = 2 * y; j < min(2 * y + 2, heights[level - 1]); j++) {
+        for (int i = 2 * x; i < min(2 * x + 2, widths[level - 1]); i++) {
+            const Light &child = levels[level - 1][j * widths[level - 1] + i];
+            /* Leave out places that haven't been loaded. */
+            if (child.a != 0) {
+                r += child.r;
+                g += child.g;
+                b += child.b;
+                known++;
+            }
+        }
+    }
+
+    Light &pixel = levels[level][y * widths[level] + x];
+    if (known == 0) {
+        pixel = Light(0, 0, 0, 0);
+    }
+    else {
+        pixel = Light(r / known, g / known, b / known, 255);
+    }
+}
+
+void MapOverview::propagate(int left, int right, int bottom, int top) {
+    for (int level = 1; level < (int)levels.size(); level++) {
+        /* Each pixel covers two of the one below it each way. */
+        left /= 2;
+        bottom /= 2;
+        right = (right + 1) / 2;
+        top = (top + 1) / 2;
+        for (int y = bottom; y < top; y++) {
+            for (int x = left; x < right; x++) {
+                average(level, x, y);
+            }
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef MAPOVERVIEW_HH
+#define MAPOVERVIEW_HH
+
+#include <vector>
+#include <cassert>
+#include "../Light.hh"
+
+/* The most detailed level of an overview has one pixel for each square of
+tiles this wide, as a power of two... */
+#define OVERVIEW_MIN_SHIFT 2
+
+/* ...unless that would make it have more pixels than this, in which case the
+squares are made bigger. */
+#define OVERVIEW_MAX_PIXELS (1 << 22)
+
+/* Pictures of a map's tile colors at several scales, each level half the
+width and height of the one before, down to a single pixel. The map keeps it
+up to date as tiles change, so it's always ready for previews and map views.
+Like the map, y = 0 is the bottom row. Pixels with an alpha of 0 are places
+that haven't been loaded yet. */
+class MapOverview {
+    /* How many tiles wide each pixel of level 0 is, as a power of two. */
+    int shift;
+
+    /* The size of each level, in pixels. */
+    std::vector<int> widths;
+    std::vector<int> heights;
+
+    /* The pixels of each level, a row at a time starting from the bottom. */
+    std::vector<std::vector<Light>> levels;
+
+    /* Set a pixel to the average of the four pixels under it in the level
+    below. */
+    void average(int level, int x, int y);
+
+public:
+    inline MapOverview() : shift(OVERVIEW_MIN_SHIFT) {}
+
+    /* Make room for a map this size. Every pixel starts out unknown. */
+    void resize(int mapWidth, int mapHeight);
+
+    /* How many tiles wide each pixel of level 0 is, as a power of two. */
+    inline int getShift() const {
+        return shift;
+    }
+
+    inline int getLevels() const {
+        return levels.size();
+    }
+
+    inline int getWidth(int level) const {
+        return widths[level];
+    }
+
+    inline int getHeight(int level) const {
+        return heights[level];
+    }
+
+    inline Light getPixel(int level, int x, int y) const {
+        assert(0 <= x && x < widths[level]);
+        assert(0 <= y && y < heights[level]);
+        return levels[level][y * widths[level] + x];
+    }
+
+    /* Set a pixel of level 0. The levels above it don't change until
+    propagate is called. */
+    inline void setPixel(int x, int y, const Light &color) {
+        assert(0 <= x && x < widths[0]);
+        assert(0 <= y && y < heights[0]);
+        levels[0][y * widths[0] + x] = color;
+    }
+
+    /* Recalculate every level above 0 over a rectangle of level 0 pixels,
+    including left and bottom but not right and top. */
+    void propagate(int left, int right, int bottom, int top);
+};
+
+#endif
@@ -5,6 +5,7 @@
 #include <cstdlib> // For randomness
 #include <cmath> // Because pi and exponentiation
 #include "Mapgen.hh"
+#include "ChunkLoader.hh"
 #include "../version.hh"
 #include "../util/PathToExecutable.hh"
 
@@ -15,31 +16,175 @@ using json = nlohmann::json;
 #define LAND_SLOPE 20
 #define SHORE_SIZE 40
 
+static_assert(WATER_BAND_WIDTH % CHUNK_SIZE == 0,
+    "Each chunk has to be in just one water band.");
+
+/* How many layers of water with nothing over them get taken away after
+water first settles. */
+#define WATER_REMOVE_DEPTH 20
+
 void Mapgen::setSize(int x, int y) {
+    if (requestedWidth > 0 && requestedHeight > 0) {
+        x = requestedWidth;
+        y = requestedHeight;
+    }
     map.setHeight(y);
     map.setWidth(x);
-    map.biomes.resize(map.biomesWide * map.biomesHigh);
-    assert(map.tiles == nullptr);
-    map.tiles = new SpaceInfo[map.width * map.height];
+    map.makeChunkTable();
+    map.streamed = streamed;
+    if (!streamed) {
+        map.makeAllChunks();
+    }
     cylinderScale.SetXScale((map.width / 2.0) / M_PI);
     cylinderScale.SetZScale(cylinderScale.GetXScale());
-    surfaces.resize(x, 0);
+    surfaces.resize(x, streamed? -1 : 0);
+    grounds.assign(x, -1);
+    int bands = (x + WATER_BAND_WIDTH - 1) / WATER_BAND_WIDTH;
+    waterBands.assign(bands, WaterBand());
+    for (int i = 0; i < bands; i++) {
+        waterBands[i].settled = false;
+    }
+    waterTally.found = 0;
+    waterTally.removed = 0;
+    waterTally.settled = 0;
+
+    int regions = (x + STRUCTURE_REGION_WIDTH - 1) / STRUCTURE_REGION_WIDTH;
+    structurePlans.assign(regions, vector<StructurePlacement>());
+    structuresPlanned.assign(regions, false);
+}
+
+void Mapgen::inform(CreateState newState, int percent) {
+    startTiming(newState);
+    m -> lock();
+    *state = newState;
+    *progress = percent;
+    m -> unlock();
 }
 
-void Mapgen::generateEarth(CreateState *state, mutex *m) {
+void Mapgen::startTiming(CreateState newState) {
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    chrono::duration<double> elapsed = now - lastTime;
+    stageSeconds[(int)timedState] += elapsed.count();
+    timedState = newState;
+    lastTime = now;
+}
+
+void Mapgen::runFused(const vector<BandStage> &stages) {
+    assert(!stages.empty());
+    int bands = (map.width + MAPGEN_BAND_WIDTH - 1) / MAPGEN_BAND_WIDTH;
+    for (int band = 0; band < bands; band++) {
+        /* Inform on status. */
+        inform(stages[0].state, 100 * band / bands);
+
+        int start = band * MAPGEN_BAND_WIDTH;
+        int stop = min(start + MAPGEN_BAND_WIDTH, map.width);
+        for (unsigned int i = 0; i < stages.size(); i++) {
+            startTiming(stages[i].state);
+            (this ->* stages[i].run)(start, stop, 0, map.height);
+        }
+    }
+}
+
+void Mapgen::generateEarth() {
     /* Set height and width, and use them to make a tile array. */
-    setSize(2048 * 3, 2048);
+    setSize(EARTH_WIDTH, EARTH_HEIGHT);
+
+    /* Inform on status. */
+    inform(CreateState::GENERATING_BIOMES, 0);
+    setupEarth();
+    findBiomePercentiles();
+
+    /* Everything up to the rock type only looks at one column at a time. */
+    runFused({
+        {CreateState::GENERATING_BIOMES, &Mapgen::setBiomes},
+        {CreateState::GENERATING_TERRAIN, &Mapgen::addTerrain},
+        {CreateState::ADDING_GLOWSTONE, &Mapgen::addGlowstone},
+        {CreateState::FELSIC, &Mapgen::setFelsic}
+    });
+
+    /* Where the shore goes depends on the surface of the whole map. */
+    inform(CreateState::ADDING_DIRT, 0);
+    findShores();
+    runFused({{CreateState::ADDING_DIRT, &Mapgen::putDirt}});
+
+    /* Water can flow any distance sideways. */
+    inform(CreateState::SETTLING_WATER, 0);
+    waterTally.found += countWater(0, map.width, 0, map.height);
+    settleWater();
+    waterTally.removed += removeWater(WATER_REMOVE_DEPTH);
+    settleWater();
+    waterTally.settled += countWater(0, map.width, 0, map.height);
+
+    /* Structures go in all at once, so the edits can be sorted by chunk. */
+    inform(CreateState::PLACING_STRUCTURES, 0);
+    placeStructures(0, map.width, 0, map.height);
+
+    /* When done setting non-boulders and before setting boulders, have
+    all the tiles choose a random variant. */
+    runFused({
+        {CreateState::GENERATING_OCEAN, &Mapgen::fillOcean},
+        {CreateState::GENERATING_OCEAN, &Mapgen::initializeVariants}
+    });
+}
+
+void Mapgen::setupStreamedEarth() {
+    setSize(STREAMED_EARTH_WIDTH, STREAMED_EARTH_HEIGHT);
+    setupEarth();
+    findBiomePercentiles();
+    estimateShores();
+}
+
+void Mapgen::setupChunks(int newSeed, int width, int height) {
+    seed = newSeed;
+    setRequestedSize(width, height);
+    setStreamed(true);
+    prepare();
+    setupStreamedEarth();
+}
+
+void Mapgen::generateChunk(Chunk *chunk, int chunkX, int chunkY) {
+    int index = chunkY * map.chunksWide + chunkX;
+    assert(map.chunks[index] == nullptr);
+    map.chunks[index] = chunk;
+
+    int left = chunkX * CHUNK_SIZE;
+    int right = min(left + CHUNK_SIZE, map.width);
+    int bottom = chunkY * CHUNK_SIZE;
+    int top = min(bottom + CHUNK_SIZE, map.height);
+
+    /* Steps that care about the surface need to know it for the whole
+    column, not just this chunk. */
+    for (int i = left; i < right; i++) {
+        getColumnSurface(i);
+    }
+
+    /* The same steps as generateEarth, in the same order. */
+    const vector<BandStage> stages = {
+        {CreateState::GENERATING_BIOMES, &Mapgen::setBiomes},
+        {CreateState::GENERATING_TERRAIN, &Mapgen::addTerrain},
+        {CreateState::ADDING_GLOWSTONE, &Mapgen::addGlowstone},
+        {CreateState::FELSIC, &Mapgen::setFelsic},
+        {CreateState::ADDING_DIRT, &Mapgen::putDirt},
+        {CreateState::SETTLING_WATER, &Mapgen::settleChunkWater},
+        {CreateState::PLACING_STRUCTURES, &Mapgen::placeStructures},
+        {CreateState::GENERATING_OCEAN, &Mapgen::fillOcean},
+        {CreateState::GENERATING_OCEAN, &Mapgen::initializeVariants}
+    };
+    for (unsigned int i = 0; i < stages.size(); i++) {
+        (this ->* stages[i].run)(left, right, bottom, top);
+    }
+
+    /* The chunk belongs to whoever asked for it. */
+    map.chunks[index] = nullptr;
+}
 
+void Mapgen::setupEarth() {
     baseHeight = map.height * 0.8;
     seaLevel = map.height * 0.72;
     seafloorLevel = map.height * 0.5;
     shoreline = map.width * 0.25;
     abyss = map.width * 0.35; 
-
-    /* Inform on status. */
-    m -> lock();
-    *state = CreateState::GENERATING_BIOMES;
-    m -> unlock();
+    cavernHeight = map.height * 0.5;
 
     /* Some constants to use in the perlin moise. */
     const int octaves = 2;
@@ -48,214 +193,334 @@ void Mapgen::generateEarth(CreateState *state, mutex *m) {
 
     /* Make a Perlin noise module for temperature, humidity, and magicalness,
     for use in determining biome. */
-    module::Perlin baseTemperature;
     baseTemperature.SetOctaveCount(octaves);
     baseTemperature.SetPersistence(persistence);
-    baseTemperature.SetSeed(rand());
-    module::ScalePoint scaledTemperature;
+    baseTemperature.SetSeed(generator());
     scaledTemperature.SetScale(scale);
     scaledTemperature.SetSourceModule(0, baseTemperature);
-    module::Turbulence finalTemperature;
     finalTemperature.SetSourceModule(0, scaledTemperature);
     finalTemperature.SetFrequency(scale);
-    
 
     /* Same, but for humidity. */
-    module::Perlin baseHumidity;
     baseHumidity.SetOctaveCount(octaves);
     baseHumidity.SetPersistence(persistence);
-    baseTemperature.SetSeed(rand());
-    module::ScalePoint scaledHumidity;
+    baseTemperature.SetSeed(generator());
     scaledHumidity.SetScale(scale);
     scaledHumidity.SetSourceModule(0, baseHumidity);
-    module::Turbulence finalHumidity;
     finalHumidity.SetSourceModule(0, scaledHumidity);
     finalHumidity.SetFrequency(scale);
 
-    const int nsamples = 10000;
-    vector<double> tempPercentiles;
-    vector<double> humidityPercentiles;
-    for (unsigned int i = 0; i < biomeData.size() - 1; i++) {
-        double percentile = (i + 1) / (double)biomeData.size();
-        tempPercentiles.push_back(getPercentile(percentile, finalTemperature,
-            nsamples));
-        humidityPercentiles.push_back(getPercentile(percentile, finalHumidity,
-            nsamples));
-    }
-
-    /* Use the temperature and humidity to get the actual biomes. */
-    for (int i = 0; i < map.biomesWide; i++) {
-        for (int j = 0; j < map.biomesHigh; j++) {
-            int x = i * BIOME_SIZE;
-            int y = j * BIOME_SIZE;
-            double temperature = getCylinderValue(x, y, finalTemperature);
-            double humidity = getCylinderValue(x, y, finalHumidity);
-            BiomeInfo info;
-            info.biome = getBaseBiome(temperature, humidity, tempPercentiles,
-                humidityPercentiles);
-            map.setBiome(i, j, info);
-        }
-    }
-
-    /* Inform on status. */
-    m -> lock();
-    *state = CreateState::GENERATING_TERRAIN;
-    m -> unlock();
-
-    /* Now that biomes are set, make a cave system. */
-    module::RidgedMulti baseCaves;
-    baseCaves.SetSeed(rand());
-    module::Turbulence turbulentCaves;
+    /* Now make a cave system. */
+    baseCaves.SetSeed(generator());
     turbulentCaves.SetSourceModule(0, baseCaves);
-    module::ScalePoint finalCaves;
     finalCaves.SetSourceModule(0, turbulentCaves);
     finalCaves.SetScale(0.005);
     finalCaves.SetYScale(2 * finalCaves.GetYScale());
-    double caveBoundary = getPercentile(0.75, finalCaves, 10000);
+    caveBoundary = getPercentile(0.75, finalCaves, 10000,
+        PercentileSalt::CAVES);
 
     /* Add a system of tunnels to hopefully connect the caves. */
-    module::RidgedMulti baseTunnels;
-    baseTunnels.SetSeed(rand());
-    module::Turbulence turbulentTunnels;
-    turbulentTunnels.SetSourceModule(0, baseTunnels);
-    module::ScalePoint finalTunnels;
+    baseTunnels.SetSeed(generator());
     finalTunnels.SetSourceModule(0, baseTunnels);
     finalTunnels.SetScale(0.0011);
     finalTunnels.SetYScale(3 * finalTunnels.GetYScale());
-    double tunnelBoundary = getPercentile(0.85, finalTunnels, 10000);
+    tunnelBoundary = getPercentile(0.85, finalTunnels, 10000,
+        PercentileSalt::TUNNELS);
+
     /* A perlin noise to use for getting the surface. */
-    module::Perlin baseSurface;
-    baseSurface.SetSeed(rand());
-    module::Turbulence turbulentSurface;
+    baseSurface.SetSeed(generator());
     turbulentSurface.SetSourceModule(0, baseSurface);
-    module::ScalePoint finalSurface;
     finalSurface.SetSourceModule(0, turbulentSurface);
     const double hillScale = 0.001;
     finalSurface.SetScale(hillScale);
 
-    cavernHeight = map.height * 0.5;
-    double caveLimit = getPercentile(0.125, finalSurface, 10000);
-    caveLimit -= getPercentile(0.875, finalCaves, 10000);
-    double cavernLimit = getPercentile(0.05, finalSurface, 10000);
-    cavernLimit -= getPercentile(0.95, finalCaves, 10000);
+    caveLimit = getPercentile(0.125, finalSurface, 10000,
+        PercentileSalt::SURFACE);
+    caveLimit -= getPercentile(0.875, finalCaves, 10000,
+        PercentileSalt::CAVES);
+    cavernLimit = getPercentile(0.05, finalSurface, 10000,
+        PercentileSalt::SURFACE);
+    cavernLimit -= getPercentile(0.95, finalCaves, 10000,
+        PercentileSalt::CAVES);
 
     /* Wetness as in whether there is actually water there right now. */
-    module::Perlin baseWetness;
-    baseWetness.SetSeed(rand());
-    module::Turbulence turbulentWetness;
+    baseWetness.SetSeed(generator());
     turbulentWetness.SetSourceModule(0, baseWetness);
-    module::ScalePoint scaledWetness;
     scaledWetness.SetSourceModule(0, turbulentWetness);
     scaledWetness.SetScale(0.01);
-    module::ScaleBias biasedWetness;
     biasedWetness.SetSourceModule(0, scaledWetness);
     biasedWetness.SetScale(1.5);
-    module::Add finalWetness;
     finalWetness.SetSourceModule(0, biasedWetness);
     finalWetness.SetSourceModule(1, finalHumidity);
 
-    double waterLimit = getPercentile(0.85, finalWetness, 10000);
+    waterLimit = getPercentile(0.85, finalWetness, 10000,
+        PercentileSalt::WETNESS);
 
-    /* Make terrain and caves. */
-    for (int i = 0; i < map.width; i++) {
-        for (int j = 0; j < map.height; j++) {
-            TileType tileType = TileType::STONE;
+    /* Perlin noise for felsic / mafic gradient. */
+    baseFelsic.SetSeed(generator());
+    turbulentFelsic.SetSourceModule(0, baseFelsic);
+    finalFelsic.SetScale(0.001);
+    finalFelsic.SetSourceModule(0, turbulentFelsic);
+    basaltLimit = getPercentile(0.25, finalFelsic, 10000,
+        PercentileSalt::FELSIC);
+    graniteLimit = getPercentile(0.75, finalFelsic, 10000,
+        PercentileSalt::FELSIC);
+    peridotLimit = getPercentile(0.05, finalFelsic, 10000,
+        PercentileSalt::FELSIC);
+
+    /* And for dirt. */
+    baseDirt.SetSeed(generator());
+    turbulentDirt.SetSourceModule(0, baseDirt);
+    finalDirt.SetScale(0.04);
+    finalDirt.SetSourceModule(0, turbulentDirt);
+    minDirt = getPercentile(0.01, finalDirt, 10000,
+        PercentileSalt::DIRT);
 
-            /* Find the sky and make it empty. */
-            double surface = getSurface(i, j, finalSurface, WorldType::EARTH);
-            if (surface > 0) {
-                tileType = TileType::EMPTY;
-            }
- 
-            /* Set the caves to be empty. */ 
-            double cave = getCylinderValue(i, j, finalCaves);
-            if (cave > caveBoundary 
-                    && surface - cave < caveLimit) {
-                tileType = TileType::EMPTY;
-            }
+    bigDirt.SetScale(0.001);
+    bigDirt.SetSourceModule(0, turbulentDirt);
+}
 
-            /* Set the tunnels to be empty. */            
-            if (isTunnel(i, j, finalTunnels, surface, tunnelBoundary, 
-                    cavernLimit)) {
-                tileType = TileType::EMPTY;
+void Mapgen::findBiomePercentiles() {
+    const int nsamples = 10000;
+    tempPercentiles.clear();
+    humidityPercentiles.clear();
+    for (unsigned int i = 0; i < biomeData.size() - 1; i++) {
+        double percentile = (i + 1) / (double)biomeData.size();
+        tempPercentiles.push_back(getPercentile(percentile, finalTemperature,
+            nsamples, PercentileSalt::TEMPERATURE));
+        humidityPercentiles.push_back(getPercentile(percentile, finalHumidity,
+            nsamples, PercentileSalt::HUMIDITY));
+    }
+}
+
+void Mapgen::setBiomes(int left, int right, int bottom, int top) {
+    assert(left % BIOME_SIZE == 0);
+    assert(bottom % BIOME_SIZE == 0);
+    /* Use the temperature and humidity to get the actual biomes. */
+    for (int x = left; x < right; x += BIOME_SIZE) {
+        for (int y = bottom; y < top; y += BIOME_SIZE) {
+            BiomeInfo info;
+            info.biome = getBiomeAt(x, y);
+            map.setBiome(x / BIOME_SIZE, y / BIOME_SIZE, info);
+        }
+    }
+}
+
+BiomeType Mapgen::getBiomeAt(int x, int y) {
+    /* Biomes are decided at the corner of their square. */
+    x -= x % BIOME_SIZE;
+    y -= y % BIOME_SIZE;
+    double temperature = getCylinderValue(x, y, finalTemperature);
+    double humidity = getCylinderValue(x, y, finalHumidity);
+    return getBaseBiome(temperature, humidity, tempPercentiles,
+        humidityPercentiles);
+}
+
+TileType Mapgen::getTerrain(int x, int y, bool &tunnel) {
+    TileType tileType = TileType::STONE;
+    tunnel = false;
+
+    /* Find the sky and make it empty. */
+    double surface = getSurface(x, y, finalSurface, WorldType::EARTH);
+    if (surface > 0) {
+        tileType = TileType::EMPTY;
+    }
+
+    /* Set the caves to be empty. */ 
+    double cave = getCylinderValue(x, y, finalCaves);
+    if (cave > caveBoundary 
+            && surface - cave < caveLimit) {
+        tileType = TileType::EMPTY;
+    }
+
+    /* Set the tunnels to be empty. */            
+    if (isTunnel(x, y, finalTunnels, surface, tunnelBoundary, 
+            cavernLimit)) {
+        tileType = TileType::EMPTY;
+        tunnel = true;
+    }
+
+    /* Add water instead of air to moist underground areas. */
+    if (tileType == TileType::EMPTY && surface <= 0
+            && getCylinderValue(x, y, finalWetness) > waterLimit) {
+        tileType = TileType::WATER;
+    }
+
+    return tileType;
+}
+
+int Mapgen::findColumnSurface(int x) {
+    bool tunnel;
+    for (int y = map.height - 1; y >= 0; y--) {
+        if (getTerrain(x, y, tunnel) == TileType::STONE) {
+            return y;
+        }
+    }
+    return 0;
+}
+
+void Mapgen::addTerrain(int left, int right, int bottom, int top) {
+    /* Also find the tunnels in the row below, for addGlowstone. */
+    int below = max(bottom - 1, 0);
+    int bandWidth = right - left;
+    bandTunnels.assign(bandWidth * (top - below), false);
+
+    /* Go a row at a time, since that's the order the tiles are stored in. */
+    for (int j = below; j < top; j++) {
+        for (int i = left; i < right; i++) {
+            bool tunnel;
+            TileType tileType = getTerrain(i, j, tunnel);
+            bandTunnels[(j - below) * bandWidth + i - left] = tunnel;
+            if (j < bottom) {
+                continue;
             }
 
             /* Figure out where the top of the ground is. */
-            if (tileType != TileType::EMPTY) {
+            if (tileType == TileType::STONE) {
                 surfaces[i] = max(j, surfaces[i]);
             }
 
-            /* Add water instead of air to moist underground areas. */
-            if (tileType == TileType::EMPTY && surface <= 0
-                    && getCylinderValue(i, j, finalWetness) > waterLimit) {
-                tileType = TileType::WATER;
-            }
-
             map.setTileType(i, j, MapLayer::FOREGROUND, tileType);
         }
     }
+}
 
-    /* Inform on status. */
-    m -> lock();
-    *state = CreateState::ADDING_GLOWSTONE;
-    m -> unlock();
-    /* Put glowstone on tunnel ceilings. */
-    for (int i = 0; i < map.width; i++) {
-        for (int j = 0; j < map.height; j++) {
-            /* Find the sky and make it empty. */
-            double surface = getSurface(i, j, finalSurface, WorldType::EARTH);
-
-            if(isTunnel(i, j, finalTunnels, surface, tunnelBoundary, 
-                    cavernLimit)
-                    && map.isOnMap(i, j+1) 
+void Mapgen::addGlowstone(int left, int right, int bottom, int top) {
+    int below = max(bottom - 1, 0);
+    int bandWidth = right - left;
+    for (int j = below; j < top - 1; j++) {
+        for (int i = left; i < right; i++) {
+            if (bandTunnels[(j - below) * bandWidth + i - left]
                     && map.getTileType(i, j+1, MapLayer::FOREGROUND) 
                         == TileType::STONE) { 
-                map.setTile(i, j+1, MapLayer::FOREGROUND, TileType::GLOWSTONE);
+                map.setTileType(i, j+1, MapLayer::FOREGROUND, 
+                    TileType::GLOWSTONE);
             }
         }
     }
+}
 
-    /* Inform on status. */
-    m -> lock();
-    *state = CreateState::FELSIC;
-    m -> unlock();
-    setFelsic();
-
-    /* Inform on status. */
-    m -> lock();
-    *state = CreateState::ADDING_DIRT;
-    m -> unlock();
-    putDirt();
+void Mapgen::fillOcean(int left, int right, int bottom, int top) {
+    for (int i = left; i < right; i++) {
+        /* The ocean only goes above the ground, where nothing is in the
+        way, so this doesn't need to look at the rest of the column. magic
+        number 30 is bigger than random surface variations but small enough
+        to still be below any floating islands. */
+        int ground = getColumnGround(i);
+        int high = min(min(baseHeight + 30, seaLevel - 1), top - 1);
+        for (int j = high; j > ground && j >= bottom; j--) {
+            if (map.getTileType(i, j, MapLayer::FOREGROUND)
+                    != TileType::EMPTY) {
+                break;
+            }
+            map.setTileType(i, j, MapLayer::FOREGROUND, TileType::WATER);
+        }
+    }
+}
 
-    /* Inform on status. */
-    m -> lock();
-    *state = CreateState::SETTLING_WATER;
-    m -> unlock();
+void Mapgen::planStructures(int region) {
+    structuresPlanned[region] = true;
+    vector<StructurePlacement> &plan = structurePlans[region];
+    int regionLeft = region * STRUCTURE_REGION_WIDTH;
+    int regionRight = min(regionLeft + STRUCTURE_REGION_WIDTH, map.width);
+
+    /* Each region has its own random numbers, so it comes out the same no
+    matter what was planned or generated before it. */
+    seed_seq sequence = {seed, region};
+    mt19937 random(sequence);
+    StructureIndex index;
+
+    for (unsigned int p = 0; p < prefabs.size(); p++) {
+        const Prefab &prefab = prefabs[p];
+        int low = regionLeft + prefab.spacing;
+        int high = regionRight - prefab.spacing - prefab.width;
+        if (high < low) {
+            continue;
+        }
+        uniform_int_distribution<int> across(low, high);
+        uniform_int_distribution<int> depth(prefab.minDepth, prefab.maxDepth);
+
+        for (int i = 0; i < prefab.tries; i++) {
+            int x = across(random);
+            int middle = x + prefab.width / 2;
+            int ground = getColumnGround(middle);
+            int y;
+            if (prefab.place == StructurePlace::SURFACE) {
+                y = ground + 1 - prefab.sink;
+            }
+            else {
+                y = ground - depth(random);
+            }
+            if (y < 1 || y + prefab.height >= map.height
+                    || !prefab.allows(getBiomeAt(middle, y))) {
+                continue;
+            }
 
-    settleWater();
-    removeWater(20);
-    settleWater();
+            StructureBox box = {x, y, x + prefab.width, y + prefab.height};
+            if (!index.isClear(box, prefab.spacing)) {
+                continue;
+            }
 
-    m -> lock();
-    *state = CreateState::GENERATING_OCEAN;
-    m -> unlock();
-    /* Fill the ocean. */
-    for (int i = 0; i < map.width; i++) {
-        /* magic number 30 is bigger than random surface variations but small
-        enough to still be below any floating islands. */
-        for (int j = baseHeight + 30; j >= 0; j--) {
-            if (map.getTileType(i, j, MapLayer::FOREGROUND) != TileType::EMPTY) {
-                break;
+            /* Only build on dry land that's close to flat. */
+            if (prefab.place == StructurePlace::SURFACE && (ground < seaLevel
+                    || abs(getColumnGround(x) - ground) > 1
+                    || abs(getColumnGround(box.right - 1) - ground) > 1)) {
+                continue;
             }
-            if (j < seaLevel) {
-                map.setTileType(i, j, MapLayer::FOREGROUND, TileType::WATER);
+
+            index.add(box);
+            plan.push_back({(int)p, x, y});
+        }
+    }
+}
+
+void Mapgen::placeStructures(int left, int right, int bottom, int top) {
+    vector<TileEdit> edits;
+    /* Structures never cross from one region to the next. */
+    int firstRegion = left / STRUCTURE_REGION_WIDTH;
+    int lastRegion = (right - 1) / STRUCTURE_REGION_WIDTH;
+    for (int region = firstRegion; region <= lastRegion; region++) {
+        if (!structuresPlanned[region]) {
+            planStructures(region);
+        }
+
+        const vector<StructurePlacement> &plan = structurePlans[region];
+        for (unsigned int i = 0; i < plan.size(); i++) {
+            const Prefab &prefab = prefabs[plan[i].prefab];
+            /* Only the part inside the rectangle. */
+            int startX = max(plan[i].x, left);
+            int stopX = min(plan[i].x + prefab.width, right);
+            int startY = max(plan[i].y, bottom);
+            int stopY = min(plan[i].y + prefab.height, top);
+            for (int y = startY; y < stopY; y++) {
+                for (int x = startX; x < stopX; x++) {
+                    int tile = (y - plan[i].y) * prefab.width + x - plan[i].x;
+                    if (prefab.foreground[tile] != -1) {
+                        edits.push_back({x, y, MapLayer::FOREGROUND,
+                            (TileType)prefab.foreground[tile]});
+                    }
+                    if (prefab.background[tile] != -1) {
+                        edits.push_back({x, y, MapLayer::BACKGROUND,
+                            (TileType)prefab.background[tile]});
+                    }
+                }
             }
         }
     }
+    map.applyEdits(edits);
+}
 
-    /* When done setting non-boulders and before setting boulders, have
-    all the tiles choose a random variant. */
-    map.initializeVariants();
+void Mapgen::initializeVariants(int left, int right, int bottom, int top) {
+    for (int j = bottom; j < top; j++) {
+        for (int i = left; i < right; i++) {
+            Location front(i, j, MapLayer::FOREGROUND);
+            Location back(i, j, MapLayer::BACKGROUND);
+            map.setForegroundVariant(i, j, map.getForeground(i, j)
+                -> getInitialVariant(map.getTileRandom(front)));
+            map.setBackgroundVariant(i, j, map.getBackground(i, j)
+                -> getInitialVariant(map.getTileRandom(back)));
+        }
+    }
 }
 
 void Mapgen::generateTest() {
@@ -275,31 +540,26 @@ double Mapgen::getCylinderValue(int x, int y, const module::Module &values) {
 }
 
 double Mapgen::getPercentile(double percentile, module::Module &values, 
-        int samples) {
-    /* Seed rand() with the module's seed so this always gives the same result
-    for the same module. */
+        int samples, PercentileSalt salt) {
+    /* Sample with a stream of its own so this always gives the same result
+    for the same module, no matter what used random numbers before it. */
+    RandomStream random((unsigned int)seed, (unsigned int)salt, samples);
     vector<double> results;
+    results.reserve(samples);
     for (int i = 0; i < samples; i++) {
-        double value = values.GetValue(rand(), rand(), rand());
-        /* Find where in the vector to insert it. */
-        int j;
-        for (j = 0; j < i; j++) {
-            if (value <= results[j]) {
-                results.insert(results.begin() + j, value);
-                break;
-            }
-        }
-        /* If it wasn't added, it's the biggest number and should be added to
-        the end. */
-        if (j == i) {
-            results.push_back(value);
-        }
-        assert((int)results.size() == i + 1);
+        double x = random.below(RAND_MAX);
+        double y = random.below(RAND_MAX);
+        double z = random.below(RAND_MAX);
+        results.push_back(values.GetValue(x, y, z));
     }
 
+    /* Only the one value needs to end up where it would be if the results
+    were sorted. This is much faster than sorting them all, which matters
+    because streamed worlds do this every time they're loaded. */
     int index = (int)(percentile * (double)samples);
-    assert(index <= samples);
+    assert(index < samples);
     assert(0 <= index);
+    nth_element(results.begin(), results.begin() + index, results.end());
     return results[index];
 }
 
@@ -324,7 +584,6 @@ BiomeType Mapgen::getBaseBiome(double temperature, double humidity,
     return (BiomeType)biomeData[t][h];
 }
 
-
 double Mapgen::ocean(int x, int y) {
     double steepness = 50;
     double surface = (y - baseHeight) / steepness;
@@ -351,31 +610,16 @@ double Mapgen::ocean(int x, int y) {
     return surface;
 }
 
-void Mapgen::setFelsic() {
-    /* Perlin noise for felsic / mafic gradient. */
-    module::Perlin baseFelsic;
-    baseFelsic.SetSeed(rand());
-    module::Turbulence turbulentFelsic;
-    turbulentFelsic.SetSourceModule(0, baseFelsic);
-    module::ScalePoint finalFelsic;
-    finalFelsic.SetScale(0.001);
-    finalFelsic.SetSourceModule(0, turbulentFelsic);
-    double basaltLimit = getPercentile(0.25, finalFelsic, 10000);
-    double graniteLimit = getPercentile(0.75, finalFelsic, 10000);
-    double peridotLimit = getPercentile(0.05, finalFelsic, 10000);
-
-    for (int i = 0; i < map.width; i++) {
-        int surface = map.height;
-        for (int j = map.height - 1; j >= 0; j--) {
+void Mapgen::setFelsic(int left, int right, int bottom, int top) {
+    for (int j = top - 1; j >= bottom; j--) {
+        for (int i = left; i < right; i++) {
             /* Figure out the felsic - mafic value of the rock. */
             TileType tileType = map.getTileType(i, j, MapLayer::FOREGROUND);
             if (tileType == TileType::STONE) {
             // Alternately:
             // if (tileType != TileType::EMPTY) {
-                if (surface == map.height) {
-                    // NOTE: floating islands could disrupt this
-                    surface = j;
-                }
+                // NOTE: floating islands could disrupt this
+                int surface = surfaces[i];
 
                 double felsic = getCylinderValue(i, j, finalFelsic);
                 double interp = 0;
@@ -414,28 +658,15 @@ void Mapgen::setFelsic() {
     }
 }
 
-void Mapgen::putDirt() {
-    module::Perlin baseDirt;
-    baseDirt.SetSeed(rand());
-    module::Turbulence turbulentDirt;
-    turbulentDirt.SetSourceModule(0, baseDirt);
-    module::ScalePoint finalDirt;
-    finalDirt.SetScale(0.04);
-    finalDirt.SetSourceModule(0, turbulentDirt);
-    double minDirt = getPercentile(0.01, finalDirt, 10000);
-
-    module::ScalePoint bigDirt;
-    bigDirt.SetScale(0.001);
-    bigDirt.SetSourceModule(0, turbulentDirt);
-
+void Mapgen::findShores() {
     /* Find the lowest part of the surface, and the locations of the 
     ocean edges. */
-    int oceanEdgeLeft = map.width / 2 - abyss;
-    int shoreLeft = map.width;
-    int shoreRight = 0;
-    int oceanEdgeRight = map.width / 2 + abyss;
+    oceanEdgeLeft = map.width / 2 - abyss;
+    shoreLeft = map.width;
+    shoreRight = 0;
+    oceanEdgeRight = map.width / 2 + abyss;
     int lowest = map.height;
-    int midocean = 0;
+    midocean = 0;
     for (int i = 0; i < map.width; i++) {
         if (surfaces[i] > seaLevel) {
             if (i < map.width / 2) {
@@ -454,67 +685,133 @@ void Mapgen::putDirt() {
 
     midocean = midocean < map.width / 2? midocean + map.width : midocean;
 
+    adjustShores();
+}
+
+void Mapgen::estimateShores() {
+    /* The land reaches sea level about where the seafloor starts to slope
+    down, and the deepest part of the ocean is about opposite the middle of
+    the land. */
+    oceanEdgeLeft = map.width / 2 - abyss;
+    shoreLeft = map.width / 2 - shoreline;
+    shoreRight = map.width / 2 + shoreline;
+    oceanEdgeRight = map.width / 2 + abyss;
+    midocean = map.width;
+
+    adjustShores();
+}
+
+void Mapgen::adjustShores() {
     /* Adjust shore locations so the beaches are a reasonable size. */
     shoreLeft += SHORE_SIZE;
     shoreRight -= SHORE_SIZE;
-    shoreLeft += (rand() % SHORE_SIZE / 2) + (rand() % SHORE_SIZE / 2);
-    shoreRight -= (rand() % SHORE_SIZE / 2) + (rand() % SHORE_SIZE / 2);
+    shoreLeft += (generator() % SHORE_SIZE / 2)
+        + (generator() % SHORE_SIZE / 2);
+    shoreRight -= (generator() % SHORE_SIZE / 2)
+        + (generator() % SHORE_SIZE / 2);
     shoreLeft = (shoreLeft + map.width / 2 - shoreline) / 2;
     shoreRight = (shoreRight + map.width / 2 + shoreline) / 2;
 
     assert(oceanEdgeLeft < shoreLeft);
     assert(shoreLeft < shoreRight);
     assert(shoreRight < oceanEdgeRight);
+}
 
+DirtColumn Mapgen::getDirtColumn(int i) {
     /* Calculate some constants. */
     int oceanAvgRight = (oceanEdgeRight + shoreRight) / 2;
     int oceanAvgLeft = (oceanEdgeLeft + shoreLeft) / 2;
     int clayRight = oceanAvgRight;
     int clayLeft = oceanAvgLeft;
-    for (int i = 0; i < map.width; i++) {
-        double clayDepth = 0;
-        double sandDepth = 0;
-        double sandDist = 0;
-        /* If it's shore, add sand. */
-        if ((i > oceanEdgeLeft && i < shoreLeft)
-                || (i > shoreRight && i < oceanEdgeRight)) {
-            double x1 = min(abs(shoreLeft - i), abs(i - shoreRight));
-            double x2 = min(abs(i - oceanEdgeLeft), abs(oceanEdgeRight - i));
-            double length = x1 + x2;
-            sandDepth = 300.0 * x1 * x2 / (length * length);
-            sandDepth *= abs(1 + getCylinderValue(i, seafloorLevel, bigDirt));
-            sandDist = x1 / length;
-            sandDepth *= sandDist;
+
+    DirtColumn column;
+    column.clayBottom = 0;
+    column.clayTop = 0;
+    column.sandBottom = 0;
+    column.sandTop = 0;
+    column.ground = getColumnSurface(i);
+    int surface = column.ground;
+    double clayDepth = 0;
+    double sandDepth = 0;
+    double sandDist = 0;
+    /* If it's shore, add sand. */
+    if ((i > oceanEdgeLeft && i < shoreLeft)
+            || (i > shoreRight && i < oceanEdgeRight)) {
+        double x1 = min(abs(shoreLeft - i), abs(i - shoreRight));
+        double x2 = min(abs(i - oceanEdgeLeft), abs(oceanEdgeRight - i));
+        double length = x1 + x2;
+        sandDepth = 300.0 * x1 * x2 / (length * length);
+        sandDepth *= abs(1 + getCylinderValue(i, seafloorLevel, bigDirt));
+        sandDist = x1 / length;
+        sandDepth *= sandDist;
+    }
+
+    if (i >  clayRight || i < clayLeft) {
+        int x = i < map.width / 2? i + map.width : i;
+        double dist = abs(x - midocean);
+        int length = x < midocean? midocean - clayRight
+                : clayLeft + map.width - midocean;
+        double shoredist = (length - dist) / length;
+        assert(dist <= length);
+        assert(0 <= dist);
+        clayDepth = 80.0 * (dist / length) * pow(shoredist, 0.4);
+        /* Y value here is arbitrary. */
+        clayDepth *= max(0.0, 0.5 + getCylinderValue(i, 0, bigDirt));
+        int level = surface + 1;
+        if ((int)clayDepth >= 1) {
+            int high = level + clayDepth;
+            column.clayBottom = level;
+            column.clayTop = high;
+            column.ground = max(column.ground, high - 1);
+            surface = high;
         }
-        
-        if (i >  clayRight || i < clayLeft) {
-            int x = i < map.width / 2? i + map.width : i;
-            double dist = abs(x - midocean);
-            int length = x < midocean? midocean - clayRight
-                    : clayLeft + map.width - midocean;
-            double shoredist = (length - dist) / length;
-            assert(dist <= length);
-            assert(0 <= dist);
-            clayDepth = 80.0 * (dist / length) * pow(shoredist, 0.4);
-            /* Y value here is arbitrary. */
-            clayDepth *= max(0.0, 0.5 + getCylinderValue(i, 0, bigDirt));
-            int level = surfaces[i] + 1;
-            if ((int)clayDepth >= 1) {
-                fillVertical(i, level, level + clayDepth,
-                    MapLayer::FOREGROUND, TileType::CLAY);
-                surfaces[i] = level + clayDepth;
-            }
+    }
+    column.surface = surface;
+    column.sandShift = sandDepth * sandDist;
+    column.hasDirt = i > oceanAvgLeft && i < oceanAvgRight;
+
+    if (sandDepth != 0) {
+        int level = surface + 1;
+        double coef = pow(sandDist, 0.5);
+        column.sandBottom = level - (1 - coef) * sandDepth;
+        column.sandTop = level + coef * sandDepth;
+        if (column.sandTop > column.sandBottom) {
+            column.ground = max(column.ground, column.sandTop - 1);
         }
-        if (i > oceanAvgLeft && i < oceanAvgRight) {
+    }
+    return column;
+}
+
+TileType Mapgen::getUnsettledTile(int x, int y, const DirtColumn &column) {
+    if ((column.clayBottom <= y && y < column.clayTop)
+            || (column.sandBottom <= y && y < column.sandTop)) {
+        return TileType::STONE;
+    }
+    /* Glowstone, rock type, and dirt only change what's already stone. */
+    bool tunnel;
+    return getTerrain(x, y, tunnel);
+}
+
+void Mapgen::putDirt(int left, int right, int bottom, int top) {
+    for (int i = left; i < right; i++) {
+        DirtColumn column = getDirtColumn(i);
+        grounds[i] = column.ground;
+        fillVertical(i, max(column.clayBottom, bottom),
+            min(column.clayTop, top), MapLayer::FOREGROUND, TileType::CLAY);
+
+        if (column.hasDirt) {
             // TODO: after adding mountains, adjust this to not put dirt
             // all the way up them
             int length = min(baseHeight - cavernHeight, 
-                    surfaces[i] - (seafloorLevel + seaLevel) / 2);
+                    column.surface - (seafloorLevel + seaLevel) / 2);
             for (int j = -1 * length; j <= 0; j++) {
                 if (length == 0) {
                     continue;
                 }
-                int y = j + surfaces[i] - sandDepth * sandDist;
+                int y = j + column.surface - column.sandShift;
+                if (y < bottom || y >= top) {
+                    continue;
+                }
                 double dirt = getCylinderValue(i, y, finalDirt) - abs(minDirt);
                 double val = (j + length) / (double)length;
                 dirt += 2 * abs(minDirt) * val;
@@ -529,15 +826,8 @@ void Mapgen::putDirt() {
             }
         }
 
-        if (sandDepth != 0) {
-            int level = surfaces[i] + 1;
-            double coef = pow(sandDist, 0.5);
-            int down = level - (1 - coef) * sandDepth;
-            int up = level + coef * sandDepth;
-            fillVertical(i, down, up, MapLayer::FOREGROUND, TileType::SAND);
-            surfaces[i] = up;
-        }
-
+        fillVertical(i, max(column.sandBottom, bottom),
+            min(column.sandTop, top), MapLayer::FOREGROUND, TileType::SAND);
     }
 }
 
@@ -657,7 +947,8 @@ void Mapgen::settleWater() {
     }
 }
 
-void Mapgen::removeWater(int removeDepth) {
+int Mapgen::removeWater(int removeDepth) {
+    int removed = 0;
     /* Remove the top removeDepth layers from each puddle. */
     for (int i = 0; i < map.width; i++) {
         int toRemove = removeDepth;
@@ -668,6 +959,7 @@ void Mapgen::removeWater(int removeDepth) {
             if (tile == TileType::WATER) {
                 map.setTileType(i, j, MapLayer::FOREGROUND, TileType::EMPTY);
                 toRemove--;
+                removed++;
             }
             /* If there's a solid tile, stop. */
             else if (tile != TileType::EMPTY) {
@@ -676,28 +968,242 @@ void Mapgen::removeWater(int removeDepth) {
             j--;
         }
     }
+    return removed;
 }
 
-Mapgen::Mapgen() : map() { }
+int Mapgen::countWater(int left, int right, int bottom, int top) const {
+    int count = 0;
+    for (int i = left; i < right; i++) {
+        for (int j = bottom; j < top; j++) {
+            count += map.getTileType(i, j, MapLayer::FOREGROUND)
+                == TileType::WATER;
+        }
+    }
+    return count;
+}
 
-void Mapgen::generate(std::string filename, WorldType worldType, 
-        CreateState *state, mutex *m) {
-    /* Seed the random number generators. */
-    map.seed = time(NULL);
-    srand(map.seed);
-    generator.seed(map.seed);
+/* Return the nearest column to i that water at i, j in a box of tiles could
+flow to along row j and fall down from, or -1 if there isn't one. Water can't
+flow through anything that isn't empty, or out of the box. */
+static int findBoxFall(const vector<TileType> &box, int width, int i, int j) {
+    const TileType *row = &box[j * width];
+    const TileType *below = row - width;
+    if (below[i] == TileType::EMPTY) {
+        return i;
+    }
+    bool left = true;
+    bool right = true;
+    for (int d = 1; left || right; d++) {
+        if (left) {
+            int x = i - d;
+            if (x < 0 || row[x] != TileType::EMPTY) {
+                left = false;
+            }
+            else if (below[x] == TileType::EMPTY) {
+                return x;
+            }
+        }
+        if (right) {
+            int x = i + d;
+            if (x >= width || row[x] != TileType::EMPTY) {
+                right = false;
+            }
+            else if (below[x] == TileType::EMPTY) {
+                return x;
+            }
+        }
+    }
+    return -1;
+}
 
-    /* Set the cylinder to get it's values from the scaled module. Of course,
-    the scaled module will need to get its values from somewhere, too. */
-    cylinder.SetModule(cylinderScale);
+/* Move each water tile in a box of tiles down as far as it can go, flowing
+sideways to get there if it has to, over and over until none of it can move.
+Every move makes the water lower, so this always stops, and water is only
+ever moved, so there's as much of it at the end as at the start. */
+static void settleBox(vector<TileType> &box, int width, int height) {
+    bool moved = true;
+    while (moved) {
+        moved = false;
+        /* j > 0 not j >= 0 because we're looking at the level below. */
+        for (int j = 1; j < height; j++) {
+            for (int i = 0; i < width; i++) {
+                if (box[j * width + i] != TileType::WATER) {
+                    continue;
+                }
+                int fall = findBoxFall(box, width, i, j);
+                if (fall == -1) {
+                    continue;
+                }
+                int lowest = j - 1;
+                while (lowest > 0 && box[(lowest - 1) * width + fall]
+                        == TileType::EMPTY) {
+                    lowest--;
+                }
+                box[j * width + i] = TileType::EMPTY;
+                box[lowest * width + fall] = TileType::WATER;
+                moved = true;
+            }
+        }
+    }
+}
 
-    /* Set the biome data vector. TODO: not hardcode filename? */
-    std::ifstream infile(PATH_TO_EXECUTABLE + "content/biomes.json");
-    if (!infile) {
-        std::cout << "Can't open " << PATH_TO_EXECUTABLE + "content/biomes.json" << "\n";
+void Mapgen::settleBand(int band) {
+    WaterBand &result = waterBands[band];
+    assert(!result.settled);
+    result.settled = true;
+    result.removed.assign(map.chunksHigh, 0);
+
+    /* Work out the whole strip, from the bottom of the map to the top. The
+    box counts as having walls at its sides, so water stays in the strip it
+    started in and no other strip has to be looked at. */
+    int left = band * WATER_BAND_WIDTH;
+    int width = min(WATER_BAND_WIDTH, map.width - left);
+    int height = map.height;
+    vector<TileType> box(width * height);
+    bool wet = false;
+    for (int i = 0; i < width; i++) {
+        DirtColumn column = getDirtColumn(left + i);
+        for (int j = 0; j < height; j++) {
+            TileType type = getUnsettledTile(left + i, j, column);
+            box[j * width + i] = type;
+            wet |= type == TileType::WATER;
+        }
+    }
+    /* Most strips are dry, and don't need to keep anything. */
+    if (!wet) {
+        return;
+    }
+
+    /* The same as generateEarth: let it settle, take away the top layers of
+    water out in the open, and let the rest settle again since it might have
+    somewhere to go now. */
+    settleBox(box, width, height);
+    for (int i = 0; i < width; i++) {
+        int toRemove = WATER_REMOVE_DEPTH;
+        for (int j = height - 1; toRemove > 0 && j >= 0; j--) {
+            TileType &type = box[j * width + i];
+            if (type == TileType::WATER) {
+                type = TileType::EMPTY;
+                toRemove--;
+                result.removed[j / CHUNK_SIZE]++;
+            }
+            else if (type != TileType::EMPTY) {
+                break;
+            }
+        }
+    }
+    settleBox(box, width, height);
+
+    result.water.resize(width * height);
+    for (int k = 0; k < width * height; k++) {
+        result.water[k] = box[k] == TileType::WATER;
+    }
+}
+
+void Mapgen::settleChunkWater(int left, int right, int bottom, int top) {
+    int band = left / WATER_BAND_WIDTH;
+    if (!waterBands[band].settled) {
+        settleBand(band);
+    }
+    const WaterBand &settled = waterBands[band];
+    int bandLeft = band * WATER_BAND_WIDTH;
+    int width = min(WATER_BAND_WIDTH, map.width - bandLeft);
+
+    waterTally.found += countWater(left, right, bottom, top);
+    waterTally.removed += settled.removed[bottom / CHUNK_SIZE];
+    for (int j = bottom; j < top; j++) {
+        for (int i = left; i < right; i++) {
+            bool water = !settled.water.empty()
+                && settled.water[j * width + i - bandLeft];
+            TileType type = map.getTileType(i, j, MapLayer::FOREGROUND);
+            if (type == TileType::WATER && !water) {
+                map.setTileType(i, j, MapLayer::FOREGROUND, TileType::EMPTY);
+            }
+            else if (type == TileType::EMPTY && water) {
+                map.setTileType(i, j, MapLayer::FOREGROUND, TileType::WATER);
+            }
+        }
+    }
+    waterTally.settled += countWater(left, right, bottom, top);
+}
+
+Mapgen::Mapgen() : map() {
+    seed = time(NULL);
+    requestedWidth = 0;
+    requestedHeight = 0;
+    streamed = false;
+    stageSeconds.resize((int)CreateState::DONE + 1, 0.0);
+    timedState = CreateState::NOT_STARTED;
+}
+
+string Mapgen::getStateName(CreateState step) {
+    switch(step) {
+        case CreateState::NONE :
+            return "none";
+        case CreateState::STUFF :
+            return "stuff";
+        case CreateState::NOT_STARTED :
+            return "setup";
+        case CreateState::GENERATING_BIOMES :
+            return "biomes";
+        case CreateState::GENERATING_TERRAIN :
+            return "terrain";
+        case CreateState::ADDING_GLOWSTONE :
+            return "glowstone";
+        case CreateState::FELSIC :
+            return "felsic";
+        case CreateState::GENERATING_OCEAN :
+            return "ocean";
+        case CreateState::ADDING_DIRT :
+            return "dirt";
+        case CreateState::SETTLING_WATER :
+            return "water";
+        case CreateState::PLACING_STRUCTURES :
+            return "structures";
+        case CreateState::SAVING :
+            return "saving";
+        case CreateState::DONE :
+            return "done";
+    }
+    assert(false);
+    return "";
+}
+
+void Mapgen::generate(std::string filename, WorldType worldType, 
+        CreateState *state_in, int *progress_in, mutex *m_in) {
+    state = state_in;
+    progress = progress_in;
+    m = m_in;
+
+    /* Anything before the first step counts as setup. */
+    fill(stageSeconds.begin(), stageSeconds.end(), 0.0);
+    timedState = CreateState::NOT_STARTED;
+    lastTime = chrono::steady_clock::now();
+
+    if (streamed && worldType != WorldType::EARTH) {
+        cerr << "Only earth worlds can be streamed.\n";
+        streamed = false;
+    }
+
+    prepare();
+    map.gravity = worldType == WorldType::MOON? MOON_GRAVITY : EARTH_GRAVITY;
+
+    /* For a streamed world, just figure out where to spawn. */
+    if (streamed) {
+        inform(CreateState::GENERATING_BIOMES, 0);
+        setupStreamedEarth();
+        map.spawn.x = map.width / 2;
+        /* Nothing above the ground exists yet, so spawning high up would
+        mean falling through chunks that are still being made. */
+        map.spawn.y = min(findColumnSurface(map.spawn.x) + 2, map.height - 1);
+        inform(CreateState::SAVING, 0);
+        /* Don't let chunks of an old world with the same name get mixed in
+        with this one. */
+        ChunkLoader::clear(filename + ".chunks");
+        map.save(filename);
+        inform(CreateState::DONE, 100);
+        return;
     }
-    json j = json::parse(infile);
-    biomeData = j["biomes"].get<std::vector<std::vector<int>>>();
 
     /* Run the appropriate function. */
     switch(worldType) {
@@ -707,7 +1213,7 @@ void Mapgen::generate(std::string filename, WorldType worldType,
         case WorldType::SMOLTEST :
             break;
         case WorldType::EARTH :
-            generateEarth(state, m);
+            generateEarth();
             break;
         default :
             cerr << "Maybe I'll implement that later." << endl;
@@ -718,16 +1224,43 @@ void Mapgen::generate(std::string filename, WorldType worldType,
     floating islands or whatever directly above the spawn point, so the
     player doesn't die of fall damage every time they respawn. */
     map.spawn.y = map.height * 0.9;
-    m -> lock();
-    *state = CreateState::SAVING;
-    m -> unlock();
+    inform(CreateState::SAVING, 0);
     map.save(filename);
-    /* TODO: remove when done testing. */
+    inform(CreateState::DONE, 100);
+}
+
+void Mapgen::saveImages(std::string filename) {
     map.savePPM(MapLayer::FOREGROUND, filename);
     map.saveBiomePPM(filename);
-    m -> lock();
-    *state = CreateState::DONE;
-    m -> unlock();
+    map.buildOverview();
+    map.saveOverviewPPM(filename, 0);
 }
 
+void Mapgen::prepare() {
+    /* Seed the random number generators. */
+    map.seed = seed;
+    generator.seed(map.seed);
+
+    /* Set the cylinder to get it's values from the scaled module. Of course,
+    the scaled module will need to get its values from somewhere, too. */
+    cylinder.SetModule(cylinderScale);
+
+    /* Set the biome data vector. TODO: not hardcode filename? */
+    std::ifstream infile(PATH_TO_EXECUTABLE + "content/biomes.json");
+    if (!infile) {
+        std::cout << "Can't open " << PATH_TO_EXECUTABLE + "content/biomes.json" << "\n";
+    }
+    json j = json::parse(infile);
+    biomeData = j["biomes"].get<std::vector<std::vector<int>>>();
 
+    /* Read in the structures. */
+    std::ifstream structureFile(PATH_TO_EXECUTABLE
+        + "content/structures.json");
+    if (!structureFile) {
+        std::cerr << "Can't open " << PATH_TO_EXECUTABLE
+            + "content/structures.json" << "\n";
+        return;
+    }
+    json structures = json::parse(structureFile);
+    prefabs = structures["structures"].get<std::vector<Prefab>>();
+}
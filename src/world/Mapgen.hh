@@ -8,8 +8,32 @@
 #include "Tile.hh"
 #include "MapHelpers.hh"
 #include "Map.hh"
+#include "Structure.hh"
 #include <mutex>
 #include <algorithm> // For max and min
+#include <chrono> // For timing each step
+
+/* How many columns of tiles world generation works on at once. A band this
+wide and as tall as the map should fit in the cache. Bands have to line up with
+the biomes. */
+#define MAPGEN_BAND_WIDTH 32
+
+/* The usual size of an earth world. A streamed world only keeps the chunks
+near players in memory, so it can be much wider. */
+#define EARTH_WIDTH (2048 * 3)
+#define EARTH_HEIGHT 2048
+#define STREAMED_EARTH_WIDTH (2048 * 16)
+#define STREAMED_EARTH_HEIGHT 2048
+
+/* A streamed world settles its water in strips of the map this many columns
+wide, each the whole height of the map and walled off from the ones next to
+it, so no water can get into or out of one. It has to be a whole number of
+chunks. */
+#define WATER_BAND_WIDTH 128
+
+/* Structures are planned for strips of the map this many columns wide, each
+on its own, so a streamed world only has to plan the strips it's using. */
+#define STRUCTURE_REGION_WIDTH 512
 
 /* How far along world creation is. */
 enum class CreateState {
@@ -23,10 +47,66 @@ enum class CreateState {
     GENERATING_OCEAN,
     ADDING_DIRT,
     SETTLING_WATER,
+    PLACING_STRUCTURES,
     SAVING,
     DONE
 };
 
+class Mapgen;
+
+/* Which noise module getPercentile is sampling, so each one is sampled in its
+own places, but always the same places for the same seed. */
+enum class PercentileSalt {
+    TEMPERATURE,
+    HUMIDITY,
+    CAVES,
+    TUNNELS,
+    SURFACE,
+    WETNESS,
+    FELSIC,
+    DIRT
+};
+
+/* Where putDirt puts clay and sand in a column. Each goes from its bottom up
+to but not including its top, and isn't there at all if those are the same.
+This only depends on the column, so every chunk of a column agrees on it. */
+struct DirtColumn {
+    int clayBottom;
+    int clayTop;
+    int sandBottom;
+    int sandTop;
+
+    /* The surface dirt is measured down from, once the clay is on, and how
+    far the sand pushes the dirt down. */
+    int surface;
+    double sandShift;
+
+    /* Whether this column gets dirt at all. */
+    bool hasDirt;
+
+    /* The highest tile that isn't empty once the clay and sand are on. */
+    int ground;
+};
+
+/* How many water tiles there were just before settling, how many settling
+took away, and how many were left once it was done, added up over everything
+generated so far. Water only moves while settling, so the ones left should
+be the ones there were less the ones taken away. */
+struct WaterTally {
+    long long found;
+    long long removed;
+    long long settled;
+};
+
+/* A step of world generation that only needs to look at the rectangle of
+tiles it is given (and maybe scratch data left by the step before it), so it can
+be run one band or one chunk at a time, fused with the other steps next to it.
+The rectangle includes left and bottom but not right and top. */
+struct BandStage {
+    CreateState state;
+    void (Mapgen::*run)(int left, int right, int bottom, int top);
+};
+
 /* A class for generating a map. */
 class Mapgen {
     /* Have a random number generator. */
@@ -35,9 +115,30 @@ class Mapgen {
     /* The seed that was used to generate the world. */
     int seed;
 
+    /* The size the map was asked to be, or 0 to use the usual size for the
+    world type. */
+    int requestedWidth;
+    int requestedHeight;
+
+    /* Whether to only set up the world, and leave generating it to be done
+    a chunk at a time when it's played. */
+    bool streamed;
+
     /* The map to generate. */
     Map map;
 
+    /* Where to report how far along generation is, and how many percent of
+    the way through the current step it is. */
+    CreateState *state;
+    int *progress;
+    std::mutex *m;
+
+    /* How many seconds have been spent on each step, indexed by CreateState,
+    and which step the time since lastTime should count towards. */
+    std::vector<double> stageSeconds;
+    CreateState timedState;
+    std::chrono::steady_clock::time_point lastTime;
+
     /* A cylinder to make noise models seamless at the edge. */
     noise::model::Cylinder cylinder;
 
@@ -47,6 +148,14 @@ class Mapgen {
     /* A 2D vector saying which percentiles map to which biomes. */
     std::vector<std::vector<int>> biomeData;
 
+    /* The kinds of structures there are. */
+    std::vector<Prefab> prefabs;
+
+    /* Where the structures go in each region, and whether that's been
+    decided yet. */
+    std::vector<std::vector<StructurePlacement>> structurePlans;
+    std::vector<bool> structuresPlanned;
+
     /* Some values for map generation. */
     int baseHeight;
     int seaLevel;
@@ -56,14 +165,184 @@ class Mapgen {
     int abyss;
 
     /* A vector of the highest solid block for each x value, not counting any
-    sort of floating island. */
+    sort of floating island. When streaming, columns that haven't been needed
+    yet are -1. */
     std::vector<int> surfaces;
 
-    /* Set the map size to x, y. */
+    /* The same, but counting the clay and sand putDirt adds. Columns that
+    haven't been needed yet are -1. */
+    std::vector<int> grounds;
+
+    /* A strip of a streamed world once its water has settled, whether the
+    water is there for each tile, one row after another, and how much water
+    settling took away from each row of chunks. Strips with no water in them
+    leave water empty. */
+    struct WaterBand {
+        bool settled;
+        std::vector<bool> water;
+        std::vector<int> removed;
+    };
+
+    /* Each strip of a streamed world, WATER_BAND_WIDTH wide. */
+    std::vector<WaterBand> waterBands;
+
+    /* The water that's been settled so far. */
+    WaterTally waterTally;
+
+    /* Which temperatures and humidities separate the biomes. */
+    std::vector<double> tempPercentiles;
+    std::vector<double> humidityPercentiles;
+
+    /* Noise modules for the earth's terrain, and the values that decide where
+    their cutoffs are. These have to live as long as the mapgen because the
+    modules keep pointers to each other. */
+    noise::module::Perlin baseTemperature;
+    noise::module::ScalePoint scaledTemperature;
+    noise::module::Turbulence finalTemperature;
+    noise::module::Perlin baseHumidity;
+    noise::module::ScalePoint scaledHumidity;
+    noise::module::Turbulence finalHumidity;
+    noise::module::RidgedMulti baseCaves;
+    noise::module::Turbulence turbulentCaves;
+    noise::module::ScalePoint finalCaves;
+    noise::module::RidgedMulti baseTunnels;
+    noise::module::ScalePoint finalTunnels;
+    noise::module::Perlin baseSurface;
+    noise::module::Turbulence turbulentSurface;
+    noise::module::ScalePoint finalSurface;
+    noise::module::Perlin baseWetness;
+    noise::module::Turbulence turbulentWetness;
+    noise::module::ScalePoint scaledWetness;
+    noise::module::ScaleBias biasedWetness;
+    noise::module::Add finalWetness;
+    double caveBoundary;
+    double caveLimit;
+    double tunnelBoundary;
+    double cavernLimit;
+    double waterLimit;
+
+    /* Same, but for the type of rock. */
+    noise::module::Perlin baseFelsic;
+    noise::module::Turbulence turbulentFelsic;
+    noise::module::ScalePoint finalFelsic;
+    double basaltLimit;
+    double graniteLimit;
+    double peridotLimit;
+
+    /* Same, but for dirt, clay, and sand. */
+    noise::module::Perlin baseDirt;
+    noise::module::Turbulence turbulentDirt;
+    noise::module::ScalePoint finalDirt;
+    noise::module::ScalePoint bigDirt;
+    double minDirt;
+
+    /* Where the beaches and the deep ocean start and stop, and the x value of
+    the middle of the ocean. These depend on every column's surface. */
+    int oceanEdgeLeft;
+    int shoreLeft;
+    int shoreRight;
+    int oceanEdgeRight;
+    int midocean;
+
+    /* Which tiles of the current band are in a tunnel, one row of the band
+    after another, starting a row below the band if there is one. Left by
+    addTerrain for addGlowstone. */
+    std::vector<bool> bandTunnels;
+
+    /* Tell whoever is waiting how far along generation is. */
+    void inform(CreateState newState, int percent);
+
+    /* Count the time since the last call towards whichever step was running,
+    and start counting time towards newState. */
+    void startTiming(CreateState newState);
+
+    /* Run every stage on the first band of columns, then every stage on the
+    next band, and so on, reporting progress after each band. Stages that
+    need the whole map to be done first should be run between calls to this,
+    not passed to it. */
+    void runFused(const std::vector<BandStage> &stages);
+
+    /* Seed the random number generators and read in the biome data. */
+    void prepare();
+
+    /* Set the map size to x, y, unless some other size was requested. If
+    not streaming, this also makes every chunk. */
     void setSize(int x, int y);
 
     /* Generate a complex world. */
-    void generateEarth(CreateState *state, std::mutex *m);
+    void generateEarth();
+
+    /* Set up the noise modules, levels, and cutoffs for an earth-like
+    world. */
+    void setupEarth();
+
+    /* Set up an earth-like world to be made a chunk at a time, without
+    making any of it. */
+    void setupStreamedEarth();
+
+    /* Figure out which temperatures and humidities separate the biomes. */
+    void findBiomePercentiles();
+
+    /* Choose the biomes. */
+    void setBiomes(int left, int right, int bottom, int top);
+
+    /* Decide the biome at x, y, without looking at the map. */
+    BiomeType getBiomeAt(int x, int y);
+
+    /* Decide what the terrain at x, y is before any other step changes it:
+    stone, empty, or water. Set tunnel to whether it's part of a tunnel. */
+    TileType getTerrain(int x, int y, bool &tunnel);
+
+    /* Find the highest solid tile of a column without generating it. */
+    int findColumnSurface(int x);
+
+    /* Return the surface of a column, finding it first if it isn't known
+    yet. */
+    inline int getColumnSurface(int x) {
+        if (surfaces[x] == -1) {
+            surfaces[x] = findColumnSurface(x);
+        }
+        return surfaces[x];
+    }
+
+    /* Return the highest tile of a column that isn't empty once the clay and
+    sand are on, finding it first if it isn't known yet. */
+    inline int getColumnGround(int x) {
+        if (grounds[x] == -1) {
+            grounds[x] = getDirtColumn(x).ground;
+        }
+        return grounds[x];
+    }
+
+    /* Work out where the clay and sand go in a column. */
+    DirtColumn getDirtColumn(int x);
+
+    /* Return what x, y is just before water settles, as EMPTY, WATER, or
+    STONE for anything else, without looking at the map. column has to be
+    the DirtColumn for x. */
+    TileType getUnsettledTile(int x, int y, const DirtColumn &column);
+
+    /* Carve caves and tunnels out of stone, put water in the wet parts, and
+    find the surface of each column. */
+    void addTerrain(int left, int right, int bottom, int top);
+
+    /* Put glowstone on tunnel ceilings. */
+    void addGlowstone(int left, int right, int bottom, int top);
+
+    /* Fill the ocean with water up to sea level. */
+    void fillOcean(int left, int right, int bottom, int top);
+
+    /* Decide where the structures in a region go. Each region keeps its
+    structures far enough from its edges that it never has to check the
+    regions next to it, so the regions can be planned in any order. */
+    void planStructures(int region);
+
+    /* Put down the parts of structures that are inside the rectangle, all
+    at once. */
+    void placeStructures(int left, int right, int bottom, int top);
+
+    /* Have every tile choose a random variant. */
+    void initializeVariants(int left, int right, int bottom, int top);
 
     /* Generate a tiny world good for testing world generation. */
     void generateTest();
@@ -74,9 +353,10 @@ class Mapgen {
     double getCylinderValue(int x, int y, const noise::module::Module &values);
 
     /* Get the number that percentile of the results will be smaller than,
-    out of the given number of samples. */
-    static double getPercentile(double percentile, 
-        noise::module::Module &values, int samples);
+    out of the given number of samples. The samples are taken in places that
+    only depend on the seed and the salt. */
+    double getPercentile(double percentile, noise::module::Module &values,
+        int samples, PercentileSalt salt);
 
     /* Choose a biome given a temperature and a humidity. This will not choose
     any biomes dependent on anything other than temperature and humidity (sky,
@@ -101,10 +381,21 @@ class Mapgen {
     }
 
     /* Choose how felsic or mafic all the rock should be. */
-    void setFelsic();
+    void setFelsic(int left, int right, int bottom, int top);
+
+    /* Find where the shores are, using the surface of every column. */
+    void findShores();
+
+    /* Guess where the shores are without looking at any columns, for
+    streamed worlds, which can't afford to look at all of them. */
+    void estimateShores();
+
+    /* Move the shores from where the land meets sea level so the beaches
+    are a reasonable size. */
+    void adjustShores();
 
     /* Put dirt, clay, and sand on the surface. */
-    void putDirt();
+    void putDirt(int left, int right, int bottom, int top);
 
     /* Get a value for determining where the level of the surface should be. */
    double getSurface(int x, int y, const noise::module::Module &surface,
@@ -138,14 +429,77 @@ class Mapgen {
     void settleWater();
 
     /* Takes a map, and removes the top removeDepth layers of water
-    not protected by an overhang. */
-    void removeWater(int removeDepth);
+    not protected by an overhang. Returns how many tiles of water it
+    removed. */
+    int removeWater(int removeDepth);
+
+    /* Count the water tiles in a rectangle of the map. */
+    int countWater(int left, int right, int bottom, int top) const;
+
+    /* Settle the water in a strip of a streamed world much like
+    generateEarth settles the whole map, but working out the tiles from
+    scratch instead of looking at the map. */
+    void settleBand(int band);
+
+    /* Put the water in a chunk of a streamed world where it goes once the
+    strip it's in has settled. */
+    void settleChunkWater(int left, int right, int bottom, int top);
 public:
     Mapgen();
 
+    /* Use this seed instead of the current time. */
+    inline void setSeed(int newSeed) {
+        seed = newSeed;
+    }
+
+    /* Make the map this size instead of the usual size for the world type.
+    Earth needs to be at least a few hundred tiles each way for the ocean and
+    shores to fit. */
+    inline void setRequestedSize(int width, int height) {
+        requestedWidth = width;
+        requestedHeight = height;
+    }
+
+    /* Make a streamed world, which is saved almost right away and generated
+    a chunk at a time as it gets played. Only earth worlds can be streamed. */
+    inline void setStreamed(bool isStreamed) {
+        streamed = isStreamed;
+    }
+
+    /* Get ready to generate chunks of a streamed world one at a time. This
+    must set things up exactly the same way as when the world was made. */
+    void setupChunks(int newSeed, int width, int height);
+
+    /* Fill in a chunk of a streamed world. */
+    void generateChunk(Chunk *chunk, int chunkX, int chunkY);
+
+    /* How many seconds the last call to generate spent on a step. Steps that
+    run fused together are still counted separately. */
+    inline double getSeconds(CreateState step) const {
+        return stageSeconds[(int)step];
+    }
+
+    /* The water settled by generate, or by generateChunk since
+    setupChunks. */
+    inline const WaterTally &getWaterTally() const {
+        return waterTally;
+    }
+
+    /* The map, once generate has made it. */
+    inline const Map &getMap() const {
+        return map;
+    }
+
+    /* A short name for a step, for reports. */
+    static std::string getStateName(CreateState step);
+
     /* Take a reference to a newly created map, and fill it with stuff. */
     void generate(std::string filename, WorldType worldType,
-        CreateState *state, std::mutex *m);
+        CreateState *state, int *progress, std::mutex *m);
+
+    /* Write pictures of the foreground, the biomes and the overview of the
+    map generate made, named after filename, to see how it came out. */
+    void saveImages(std::string filename);
 };
 
 #endif
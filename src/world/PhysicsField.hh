@@ -0,0 +1,42 @@
+#ifndef PHYSICSFIELD_HH
+#define PHYSICSFIELD_HH
+
+/* How much gravity changes the y velocity each tick, for each type of
+world. */
+#define EARTH_GRAVITY -1.5
+#define MOON_GRAVITY -0.25
+
+/* What being in water does to things' drag. */
+#define WATER_DRAG_X 0.8
+#define WATER_DRAG_Y 0.8
+
+/* How a part of the world changes the way things move through it. Each chunk
+has one. The default one doesn't change anything. */
+struct PhysicsField {
+    /* Multiplies the world's gravity. Less than 1 for low gravity. */
+    double gravityScale;
+
+    /* Added to the y velocity each tick of anything gravity pulls on, for
+    updrafts. */
+    double lift;
+
+    /* Multiplies things' own drag. Less than 1 slows things down more. */
+    double dragX;
+    double dragY;
+
+    inline PhysicsField() : gravityScale(1), lift(0), dragX(1), dragY(1) {}
+
+    inline bool isDefault() const {
+        return gravityScale == 1 && lift == 0 && dragX == 1 && dragY == 1;
+    }
+};
+
+/* What something feels in one tick, after the world's gravity, the field
+it's in and the water it's in are put together. */
+struct PhysicsSample {
+    double gravity;
+    double dragX;
+    double dragY;
+};
+
+#endif
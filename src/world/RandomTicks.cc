@@ -0,0 +1,76 @@
+#include "RandomTicks.hh"
+#include "Map.hh"
+
+using namespace std;
+
+/* How far away a light can melt ice from. */
+#define MELT_DISTANCE 2
+
+RandomTicks::RandomTicks() : handlers((int)TileType::LAST_TILE + 1, nullptr) {
+    handlers[(int)TileType::DIRT] = &growTopsoil;
+    handlers[(int)TileType::TOPSOIL] = &coverTopsoil;
+    handlers[(int)TileType::ICE] = &melt;
+    handlers[(int)TileType::SNOW] = &melt;
+}
+
+void RandomTicks::growTopsoil(Map &map, const Location &place) {
+    if (!map.getTile(place.x, place.y + 1, MapLayer::FOREGROUND)
+            -> getIsSky()) {
+        return;
+    }
+    for (int i = -1; i <= 1; i++) {
+        for (int j = -1; j <= 1; j++) {
+            if (map.getTileType(place, i, j) == TileType::TOPSOIL) {
+                map.setTile(place, TileType::TOPSOIL);
+                return;
+            }
+        }
+    }
+}
+
+void RandomTicks::coverTopsoil(Map &map, const Location &place) {
+    if (!map.getTile(place.x, place.y + 1, MapLayer::FOREGROUND)
+            -> getIsSky()) {
+        map.setTile(place, TileType::DIRT);
+    }
+}
+
+void RandomTicks::melt(Map &map, const Location &place) {
+    for (int i = -MELT_DISTANCE; i <= MELT_DISTANCE; i++) {
+        for (int j = -MELT_DISTANCE; j <= MELT_DISTANCE; j++) {
+            if (map.getTile(place.x + i, place.y + j, MapLayer::FOREGROUND)
+                    -> getEmitted() != Light(0, 0, 0, 0)) {
+                TileType type = map.getTileType(place, 0, 0);
+                map.setTile(place, type == TileType::ICE? TileType::WATER
+                    : TileType::EMPTY);
+                return;
+            }
+        }
+    }
+}
+
+void RandomTicks::update(Map &map) {
+    for (unsigned int i = 0; i < map.simulatedChunks.size(); i++) {
+        int index = map.simulatedChunks[i];
+        int left = (index % map.chunksWide) * CHUNK_SIZE;
+        int bottom = (index / map.chunksWide) * CHUNK_SIZE;
+        RandomStream random = map.getRandom(Location(left, bottom,
+            MapLayer::NONE));
+
+        for (int j = 0; j < RANDOM_TICKS_PER_CHUNK; j++) {
+            uint64_t bits = random.next();
+            int x = left + (bits & CHUNK_MASK);
+            int y = bottom + ((bits >> CHUNK_SHIFT) & CHUNK_MASK);
+            /* The last row and column of chunks can hang off the map. */
+            if (!map.isOnMap(x, y)) {
+                continue;
+            }
+            Location place(x, y, MapLayer::FOREGROUND);
+            Handler handler = handlers[(int)map.getTileType(x, y,
+                MapLayer::FOREGROUND)];
+            if (handler != nullptr) {
+                handler(map, place);
+            }
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef RANDOMTICKS_HH
+#define RANDOMTICKS_HH
+
+#include <vector>
+#include <cstdint>
+
+class Map;
+struct Location;
+
+/* How many places in each chunk get a random tick each tick. Chunks have
+4096 tiles, so at 60 ticks a second any one tile gets picked about every
+20 seconds. */
+#define RANDOM_TICKS_PER_CHUNK 3
+
+/* Slow changes to the world, like topsoil spreading over dirt or ice melting.
+Instead of keeping track of every tile that might change, each tick a few
+random places in each chunk near a player are picked, and whatever tile is
+there gets a chance to change. That costs the same no matter how many tiles
+could change. */
+class RandomTicks {
+    /* What a type of tile does when it's picked. */
+    typedef void (*Handler)(Map &map, const Location &place);
+
+    /* The handler for each TileType, or nullptr if it doesn't do anything. */
+    std::vector<Handler> handlers;
+
+    /* Dirt with open sky above it turns into topsoil if there's topsoil
+    next to it. */
+    static void growTopsoil(Map &map, const Location &place);
+
+    /* Topsoil that gets covered up turns back into dirt. */
+    static void coverTopsoil(Map &map, const Location &place);
+
+    /* Ice near a light melts into water, and snow just goes away. */
+    static void melt(Map &map, const Location &place);
+
+public:
+    RandomTicks();
+
+    /* Pick places in every simulated chunk and let the tiles there do their
+    thing. The places only depend on the seed, the tick and the chunk. */
+    void update(Map &map);
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "Structure.hh"
+#include <cassert>
+#include <iostream>
+
+using namespace std;
+using json = nlohmann::json;
+
+/* Which square of a StructureIndex a coordinate is in. This rounds down, even
+for negative numbers. */
+static int getCell(int coordinate) {
+    if (coordinate < 0) {
+        return -((-coordinate - 1) / STRUCTURE_CELL_SIZE) - 1;
+    }
+    return coordinate / STRUCTURE_CELL_SIZE;
+}
+
+bool Prefab::allows(BiomeType biome) const {
+    for (unsigned int i = 0; i < biomes.size(); i++) {
+        if (biomes[i] == biome) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void from_json(const json &j, Prefab &prefab) {
+    prefab.name = j["name"];
+    prefab.biomes.clear();
+    vector<int> biomes = j["biomes"].get<vector<int>>();
+    for (unsigned int i = 0; i < biomes.size(); i++) {
+        prefab.biomes.push_back((BiomeType)biomes[i]);
+    }
+    prefab.place = (StructurePlace)j["place"].get<int>();
+    prefab.tries = j["tries"];
+    prefab.spacing = j["spacing"];
+    prefab.sink = j.value("sink", 0);
+    prefab.minDepth = j.value("minDepth", 0);
+    prefab.maxDepth = j.value("maxDepth", 0);
+
+    /* Each character of the legend stands for a foreground and a
+    background. */
+    map<char, pair<int, int>> legend;
+    for (auto &entry : j["legend"].items()) {
+        assert(entry.key().size() == 1);
+        vector<int> tiles = entry.value().get<vector<int>>();
+        assert(tiles.size() == 2);
+        legend[entry.key()[0]] = make_pair(tiles[0], tiles[1]);
+    }
+
+    vector<string> rows = j["tiles"].get<vector<string>>();
+    prefab.height = rows.size();
+    prefab.width = rows.empty()? 0 : rows[0].size();
+    prefab.foreground.clear();
+    prefab.background.clear();
+    /* The rows are written top first, but stored bottom first like the
+    map. */
+    for (int y = prefab.height - 1; y >= 0; y--) {
+        if ((int)rows[y].size() != prefab.width) {
+            cerr << "Rows of structure " << prefab.name
+                << " aren't all the same length.\n";
+        }
+        for (int x = 0; x < prefab.width; x++) {
+            pair<int, int> tiles(-1, -1);
+            if (x < (int)rows[y].size() && legend.count(rows[y][x])) {
+                tiles = legend[rows[y][x]];
+            }
+            prefab.foreground.push_back(tiles.first);
+            prefab.background.push_back(tiles.second);
+        }
+    }
+}
+
+bool StructureIndex::isClear(const StructureBox &box, int spacing) const {
+    StructureBox near = {box.left - spacing, box.bottom - spacing,
+        box.right + spacing, box.top + spacing};
+    for (int i = getCell(near.left); i <= getCell(near.right - 1); i++) {
+        for (int j = getCell(near.bottom); j <= getCell(near.top - 1); j++) {
+            auto found = cells.find(make_pair(i, j));
+            if (found == cells.end()) {
+                continue;
+            }
+            const vector<StructureBox> &boxes = found -> second;
+            for (unsigned int k = 0; k < boxes.size(); k++) {
+                if (boxes[k].left < near.right && near.left < boxes[k].right
+                        && boxes[k].bottom < near.top
+                        && near.bottom < boxes[k].top) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void StructureIndex::add(const StructureBox &box) {
+    for (int i = getCell(box.left); i <= getCell(box.right - 1); i++) {
+        for (int j = getCell(box.bottom); j <= getCell(box.top - 1); j++) {
+            cells[make_pair(i, j)].push_back(box);
+        }
+    }
+}
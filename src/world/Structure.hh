@@ -0,0 +1,95 @@
+#ifndef STRUCTURE_HH
+#define STRUCTURE_HH
+
+#include <vector>
+#include <string>
+#include <map>
+#include <utility> // For pair
+#include <nlohmann/json.hpp>
+#include "MapHelpers.hh"
+
+/* How many tiles wide each square of a StructureIndex is. Structures bigger
+than this still work, they just get put in more squares. */
+#define STRUCTURE_CELL_SIZE 64
+
+/* Where a kind of structure can go. */
+enum class StructurePlace {
+    SURFACE, // Standing on the ground, outside
+    UNDERGROUND // Anywhere in the rock between minDepth and maxDepth
+};
+
+/* A kind of structure world generation can put on the map, like a ruin or a
+vein of ore. These are read in from content/structures.json. */
+struct Prefab {
+    std::string name;
+
+    /* Which biomes it can go in. */
+    std::vector<BiomeType> biomes;
+
+    StructurePlace place;
+
+    /* How many spots to try putting one in, in each region of the map. */
+    int tries;
+
+    /* How many tiles it has to be from any other structure. */
+    int spacing;
+
+    /* For surface structures, how many rows go below the ground. */
+    int sink;
+
+    /* For underground structures, how far under the surface they can be. */
+    int minDepth;
+    int maxDepth;
+
+    int width;
+    int height;
+
+    /* The tiles to put down, a row at a time starting from the bottom, or -1
+    to leave whatever was there. */
+    std::vector<int> foreground;
+    std::vector<int> background;
+
+    /* Return whether it can go in that biome. */
+    bool allows(BiomeType biome) const;
+};
+
+/* Get a prefab from a json. The tiles are written as rows of characters from
+the top down, and a legend saying which foreground and background tile each
+character is. */
+void from_json(const nlohmann::json &j, Prefab &prefab);
+
+/* A rectangle of tiles, including left and bottom but not right and top. */
+struct StructureBox {
+    int left;
+    int bottom;
+    int right;
+    int top;
+};
+
+/* A structure that's been given a spot. */
+struct StructurePlacement {
+    /* Which prefab it is. */
+    int prefab;
+
+    /* Where its bottom left corner goes. */
+    int x;
+    int y;
+};
+
+/* Keeps track of where structures are so checking whether a new one is too
+close to the rest only looks at the ones nearby. The structures are put in
+every square they touch, and the squares are kept in a sorted map, so each
+check is a few O(log n) lookups. */
+class StructureIndex {
+    std::map<std::pair<int, int>, std::vector<StructureBox>> cells;
+
+public:
+    /* Return whether box is at least spacing tiles from every structure
+    added so far. */
+    bool isClear(const StructureBox &box, int spacing) const;
+
+    /* Remember that there's a structure there. */
+    void add(const StructureBox &box);
+};
+
+#endif
@@ -0,0 +1,44 @@
+#include "TickWheel.hh"
+
+using namespace std;
+
+bool TickWheel::schedule(const Location &place, unsigned int when) {
+    bool isNew = false;
+    map<Location, unsigned int>::iterator found = due.find(place);
+    if (found != due.end()) {
+        if (found -> second <= when) {
+            return false;
+        }
+        found -> second = when;
+    }
+    else {
+        due[place] = when;
+        isNew = true;
+    }
+    slots[when & (TICK_WHEEL_SIZE - 1)].push_back({place, when});
+    return isNew;
+}
+
+vector<Location> TickWheel::take(unsigned int now) {
+    vector<ScheduledTile> &slot = slots[now & (TICK_WHEEL_SIZE - 1)];
+    vector<Location> ready;
+    /* Keep the ones that are due on a later turn of the wheel. */
+    unsigned int kept = 0;
+    for (unsigned int i = 0; i < slot.size(); i++) {
+        map<Location, unsigned int>::iterator found
+            = due.find(slot[i].place);
+        if (found == due.end() || found -> second != slot[i].when) {
+            continue;
+        }
+        if (slot[i].when <= now) {
+            ready.push_back(slot[i].place);
+            due.erase(found);
+        }
+        else {
+            slot[kept] = slot[i];
+            kept++;
+        }
+    }
+    slot.resize(kept);
+    return ready;
+}
@@ -0,0 +1,70 @@
+#ifndef TICKWHEEL_HH
+#define TICKWHEEL_HH
+
+#include <vector>
+#include <map>
+#include "MapHelpers.hh"
+
+/* How many ticks ahead the wheel has a slot for. Tiles can be scheduled
+further ahead than this, they just get looked at once each time the wheel
+goes around. Must be a power of two. */
+#define TICK_WHEEL_SIZE 128
+
+/* A tile waiting for its turn. */
+struct ScheduledTile {
+    Location place;
+    unsigned int when;
+};
+
+/* Keeps track of which tiles need updating on which future tick. Each tick
+has a slot, and the slots are reused as the wheel goes around, so finding
+what's due only looks at the tiles that are due (plus any scheduled more
+than a full turn ahead). Tiles that aren't scheduled cost nothing. */
+class TickWheel {
+    std::vector<std::vector<ScheduledTile>> slots;
+
+    /* When each scheduled tile is next due. Anything in a slot that doesn't
+    match this was rescheduled or cancelled, and gets ignored. */
+    std::map<Location, unsigned int> due;
+
+public:
+    inline TickWheel() : slots(TICK_WHEEL_SIZE) {}
+
+    /* Have the tile come up on tick when. If it's already scheduled sooner,
+    nothing changes. Return whether it wasn't scheduled before. */
+    bool schedule(const Location &place, unsigned int when);
+
+    /* Stop the tile from coming up. Return whether it was scheduled. */
+    inline bool cancel(const Location &place) {
+        return due.erase(place);
+    }
+
+    /* Stop every tile that condition is true for from coming up. */
+    template<class Condition>
+    void cancelIf(Condition condition) {
+        std::map<Location, unsigned int>::iterator iter = due.begin();
+        while (iter != due.end()) {
+            if (condition(iter -> first)) {
+                iter = due.erase(iter);
+            }
+            else {
+                ++iter;
+            }
+        }
+    }
+
+    inline bool contains(const Location &place) const {
+        return due.count(place);
+    }
+
+    /* How many tiles are scheduled. */
+    inline int size() const {
+        return due.size();
+    }
+
+    /* Return every tile due on tick now, and forget about them. This has to
+    be called for every tick, in order. */
+    std::vector<Location> take(unsigned int now);
+};
+
+#endif
@@ -12,8 +12,6 @@
 #include <string>
 #include <SDL2/SDL.h>
 
-#define TILE_ANIMATION_DELAY 4
-
 // For convenience
 using json = nlohmann::json;
 
@@ -39,8 +37,8 @@ int Tile::getMaxHealth() const {
     return maxHealth;
 }
 
-uint8_t Tile::getInitialVariant() const {
-    return uint8_t(rand() % getNumVariants());
+uint8_t Tile::getInitialVariant(unsigned int random) const {
+    return uint8_t(random % getNumVariants());
 }
 
 /* Deal damage to whatever is overlapping this, and stop it if this tile is 
@@ -49,16 +47,10 @@ void Tile::dealOverlapDamage(movable::Movable &movable) const {
     movable.takeDamage(overlapDamage);
 }
 
-/* Change the map in whatever way needs doing. */
+/* Change the map in whatever way needs doing. Plain tiles don't do
+anything, and animated ones are animated when they're drawn. */
 bool Tile::update(Map &map, Location place,
-        std::vector<DroppedItem*> &items, int tick) const {
-    if (isAnimated) {
-        if (tick % TILE_ANIMATION_DELAY == 0) {
-            uint8_t variant = map.getVariant(place.x, place.y, place.layer);
-            map.setVariant(place.x, place.y, place.layer, (variant + 1) % numVariants);
-        }
-        return true;
-    }
+        SlotMap<DroppedItem> &items, int tick) const {
     return false;
 }
 
@@ -91,7 +83,6 @@ Tile::Tile(TileType tileType, string name_in)
     tier = j["tier"];
     int edgeInt = j["edgeType"];
     edgeType = (EdgeType)edgeInt;
-    sprite.loadTexture(PATH_TO_EXECUTABLE + TILE_SPRITE_PATH);
 
     assert(absorbed.r >= 1.0);
     assert(absorbed.g >= 1.0);
@@ -101,12 +92,23 @@ Tile::Tile(TileType tileType, string name_in)
     assert(absorbed.a < 1.0);
 }
 
+void Tile::loadSprite() {
+    sprite.loadTexture(PATH_TO_EXECUTABLE + TILE_SPRITE_PATH);
+}
+
 /* Virtual destructor. */
 Tile::~Tile() {}
 
+int Tile::getUpdateDelay(int tick) const {
+    return 1;
+}
+
+void Tile::catchUp(Map &map, Location place,
+        SlotMap<DroppedItem> &items, int ticks) const {}
+
 /* Whether the tile will ever need to call its update function. */
 bool Tile::canUpdate(const Map &map, const Location &place) const {
-    return isAnimated;
+    return false;
 }
 
 void Tile::render(uint8_t variant, uint8_t bordering, const Light &light, 
@@ -5,9 +5,13 @@
 #include "../entity/Movable.hh"
 #include "../Light.hh"
 #include "../Damage.hh"
+#include "../util/SlotMap.hh"
 #include <vector>
 #include <string>
 
+/* How many ticks each frame of an animated tile lasts. */
+#define TILE_ANIMATION_DELAY 4
+
 /* Forward declare! */
 class Map;
 struct Location;
@@ -150,6 +154,10 @@ public:
         return canBackground;
     }
 
+    inline bool getWaterBreaks() const {
+        return waterBreaks;
+    }
+
     inline bool getTier() const {
         return tier;
     }
@@ -166,24 +174,53 @@ public:
         return numVariants;
     }
 
+    /* Which variant to draw on this tick. Animated tiles go through their
+    variants in order, starting from the one they have, so nothing about the
+    animation needs storing or updating. */
+    inline uint8_t getFrame(uint8_t variant, unsigned int tick) const {
+        if (!isAnimated) {
+            return variant;
+        }
+        return (variant + tick / TILE_ANIMATION_DELAY) % numVariants;
+    }
+
     // Variables for how it interacts with the players
     bool getIsPlatform() const;
     bool getIsSolid() const;
     void dealOverlapDamage(movable::Movable &movable) const;
 
+    /* Whether dealOverlapDamage does anything. */
+    inline bool getDealsOverlapDamage() const {
+        return overlapDamage.maxDamage != 0;
+    }
+
     /* Basically the number of hits with a pickaxe to break it. */
     int getMaxHealth() const;
 
-    /* Get a variant suitable for initializing a newly created tile. */
-    virtual uint8_t getInitialVariant() const;
+    /* Get a variant suitable for initializing a newly created tile, picked
+    using the random number. */
+    virtual uint8_t getInitialVariant(unsigned int random) const;
 
     /* Change the map in whatever way needs doing. */
     virtual bool update(Map &map, Location place,
-        std::vector<DroppedItem*> &items, int tick) const;
+        SlotMap<DroppedItem> &items, int tick) const;
+
+    /* How many ticks after tick update next needs calling. This is at
+    least 1. */
+    virtual int getUpdateDelay(int tick) const;
+
+    /* Do roughly what ticks updates would have done, all at once, for a
+    tile that was too far from any player to update. */
+    virtual void catchUp(Map &map, Location place,
+        SlotMap<DroppedItem> &items, int ticks) const;
 
     // Constructor, based on the tile type
     Tile(TileType tileType, std::string name_in);
 
+    /* Load the sprite's texture. This needs a renderer, so maps that are only
+    being generated and saved never call it. */
+    void loadSprite();
+
     /* Virtual destructor. */
     virtual ~Tile();
 
@@ -0,0 +1,60 @@
+#include "TileProfile.hh"
+#include "Map.hh"
+
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+TileProfile::TileProfile() : current(makeCounters()),
+        lastTick(makeCounters()), window(makeCounters()),
+        lastWindow(makeCounters()), total(makeCounters()), windowTicks(0),
+        ticks(0) {}
+
+void TileProfile::add(const vector<TileCounters> &counters) {
+    assert(counters.size() == current.size());
+    for (unsigned int i = 0; i < counters.size(); i++) {
+        current[i].add(counters[i]);
+    }
+}
+
+void TileProfile::endTick() {
+    for (unsigned int i = 0; i < current.size(); i++) {
+        window[i].add(current[i]);
+        total[i].add(current[i]);
+    }
+    current.swap(lastTick);
+    current.assign(current.size(), TileCounters());
+    ticks++;
+
+    windowTicks++;
+    if (windowTicks == PROFILE_WINDOW) {
+        window.swap(lastWindow);
+        window.assign(window.size(), TileCounters());
+        windowTicks = 0;
+    }
+}
+
+bool TileProfile::save(const string &filename, const Map &map) const {
+    ofstream outfile(filename);
+    if (!outfile) {
+        cerr << "Can't write the tile profile to " << filename << "\n";
+        return false;
+    }
+
+    outfile << "tile,updates,rejected,moves,ms,updates per tick,ms per tick\n";
+    double perTick = ticks == 0? 0 : 1.0 / ticks;
+    for (unsigned int i = 0; i < total.size(); i++) {
+        const TileCounters &counters = total[i];
+        if (counters.updates == 0 && counters.rejected == 0
+                && counters.moves == 0) {
+            continue;
+        }
+        double ms = counters.nanoseconds / 1000000.0;
+        outfile << map.getTileName((TileType)i) << ","
+            << counters.updates << "," << counters.rejected << ","
+            << counters.moves << "," << ms << ","
+            << counters.updates * perTick << "," << ms * perTick << "\n";
+    }
+    return true;
+}
@@ -0,0 +1,98 @@
+#ifndef TILEPROFILE_HH
+#define TILEPROFILE_HH
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "Tile.hh"
+
+class Map;
+
+/* How many ticks the recent numbers are summed over before they're shown. */
+#define PROFILE_WINDOW 60
+
+/* How much work one type of tile did. */
+struct TileCounters {
+    /* How many times update was called. */
+    unsigned int updates;
+
+    /* How many times it came up but canUpdate said no. */
+    unsigned int rejected;
+
+    /* How many times a tile of this type moved or traded places. */
+    unsigned int moves;
+
+    /* Time spent in update. */
+    uint64_t nanoseconds;
+
+    inline TileCounters() : updates(0), rejected(0), moves(0),
+            nanoseconds(0) {}
+
+    inline void add(const TileCounters &other) {
+        updates += other.updates;
+        rejected += other.rejected;
+        moves += other.moves;
+        nanoseconds += other.nanoseconds;
+    }
+};
+
+/* Keeps count of what each type of tile costs Map::update, so it's easy to
+see whether it's the sand or the boulders that make a world slow. Counting is
+cheap enough to always be on. Each tick's counts are kept until the next
+tick, summed over the last few ticks for showing on screen, and summed over
+the whole game for saving at the end. */
+class TileProfile {
+    /* Indexed by TileType. */
+    std::vector<TileCounters> current;
+    std::vector<TileCounters> lastTick;
+    std::vector<TileCounters> window;
+    std::vector<TileCounters> lastWindow;
+    std::vector<TileCounters> total;
+
+    /* How many ticks are in window and total. */
+    unsigned int windowTicks;
+    unsigned int ticks;
+
+public:
+    TileProfile();
+
+    /* The counts for this tick, to add to. */
+    inline TileCounters &count(TileType type) {
+        return current[(int)type];
+    }
+
+    /* Add counts that were kept somewhere else, like on another thread. */
+    void add(const std::vector<TileCounters> &counters);
+
+    /* Make a list of counters that add can take. */
+    static inline std::vector<TileCounters> makeCounters() {
+        return std::vector<TileCounters>((int)TileType::LAST_TILE + 1);
+    }
+
+    /* Finish off this tick's counts and start the next. */
+    void endTick();
+
+    /* Access functions. */
+    inline const TileCounters &getLastTick(TileType type) const {
+        return lastTick[(int)type];
+    }
+
+    /* The sum over the last PROFILE_WINDOW ticks. */
+    inline const TileCounters &getRecent(TileType type) const {
+        return lastWindow[(int)type];
+    }
+
+    inline const TileCounters &getTotal(TileType type) const {
+        return total[(int)type];
+    }
+
+    inline unsigned int getTicks() const {
+        return ticks;
+    }
+
+    /* Write the totals to a csv file, a line for each tile type that did
+    anything. Return whether it worked. */
+    bool save(const std::string &filename, const Map &map) const;
+};
+
+#endif
@@ -1,6 +1,6 @@
 #include "World.hh"
 
-#define ITEM_LIMIT 400
+#define ITEM_LIMIT 4000
 
 using namespace std;
 
@@ -8,20 +8,36 @@ World::World(string filename, int tileWidth, int tileHeight)
         : map(filename, tileWidth, tileHeight), player(),
         collider(tileWidth, tileHeight) {
     
-    entities.push_back(&player);
+    entities.insert(&player);
     /* Set the player's position to the spawnpoint. */
     player.setX(map.getSpawn().x * tileWidth);
     player.setY(map.getSpawn().y * tileHeight);
+    player.savePosition();
+    player.setWorldwidth(map.getWidth() * tileWidth);
 }
 
 World::~World() {
     while (!droppedItems.empty()) {
-        delete droppedItems.back();
-        droppedItems.erase(droppedItems.end() - 1);
+        delete droppedItems.eraseAt(droppedItems.size() - 1);
     }
 }
 
 void World::update() {
+    /* Make sure the map around the player is there, and updating. */
+    int playerX = player.getRect().x / map.getTileWidth();
+    int playerY = player.getRect().y / map.getTileHeight();
+    map.streamChunks(playerX, playerY);
+    map.simulateNear(playerX, playerY);
+
+    /* Give every entity its own random numbers for this tick, and remember
+    where everything starts so it can be drawn moving smoothly. */
+    for (unsigned int i = 0; i < entities.size(); i++) {
+        entities[i] -> setRandom(map.getRandom(entities[i] -> getId()));
+        entities[i] -> savePosition();
+    }
+    for (unsigned int i = 0; i < droppedItems.size(); i++) {
+        droppedItems[i] -> savePosition();
+    }
 
     /* TODO: update all entities. */
     player.update(droppedItems);
@@ -30,30 +46,21 @@ void World::update() {
     /* Move things around. */
     collider.update(map, entities, droppedItems);
 
-    /* Despawn dropped items that don't exist anymore. */
-    vector<DroppedItem*>::iterator iter = droppedItems.begin();
-    while (iter != droppedItems.end()) {
-        if (*iter == nullptr || (*iter) -> item == nullptr) {
-            delete *iter;
-            iter = droppedItems.erase(iter);
+    /* Despawn dropped items that don't exist anymore. Taking one out moves
+    the last one into its place, so look at the same place again. */
+    unsigned int i = 0;
+    while (i < droppedItems.size()) {
+        if (droppedItems[i] -> item == nullptr) {
+            delete droppedItems.eraseAt(i);
         }
         else {
-            ++iter;
+            i++;
         }
     }
 
-    /* Despawn items if there are too many. */
-    /* Note: erasing from the front of a vector is costly. If this is a problem,
-    maybe only do this once every few seconds. Alternately, can use an array
-    with some mechanism of keeping track of where the line between newest and
-    oldest items is. */
-    if (droppedItems.size() > ITEM_LIMIT) {
-        for (int i = 0; i < (int)droppedItems.size() - ITEM_LIMIT; i++) {
-            delete droppedItems[i];
-            droppedItems[i] = nullptr;
-        }
-        droppedItems.erase(droppedItems.begin(), 
-            droppedItems.begin() + (droppedItems.size() - ITEM_LIMIT));
+    /* Despawn the oldest items if there are too many. */
+    while (droppedItems.size() > ITEM_LIMIT) {
+        delete droppedItems.eraseAt(droppedItems.getOldest());
     }
 
     /* Have every movable take fall damage. */
@@ -65,3 +72,11 @@ void World::update() {
     map.update(droppedItems);
 
 }
+
+bool World::placeTile(Location place, TileType type) {
+    if (place.layer == MapLayer::FOREGROUND && map.isSolid(type)
+            && collider.tileOverlapsEntity(map, place.x, place.y, entities)) {
+        return false;
+    }
+    return map.placeTile(place, type);
+}
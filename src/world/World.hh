@@ -13,9 +13,10 @@ public:
     Map map;
     Player player;
 
-    /* Vectors to hold all the things that need to collide. */
-    std::vector<DroppedItem *> droppedItems;
-    std::vector<Entity *> entities;
+    /* All the things that need to collide. The world owns the dropped
+    items, but not the entities. */
+    SlotMap<DroppedItem> droppedItems;
+    SlotMap<Entity> entities;
 
 private:
     Collider collider;
@@ -28,6 +29,10 @@ public:
     ~World();
 
     void update();
+
+    /* Place a tile, unless it's solid and would end up on top of someone.
+    Return whether it was placed. */
+    bool placeTile(Location place, TileType type);
 };
 
 #endif
@@ -0,0 +1,133 @@
+/* Generate a world without opening a window, and report how long each step of
+world generation took and how much memory it needed at most. The report is
+tab separated so scripts can compare it between runs.
+
+Usage: worldgen [-t earth|test] [-w width -h height] [-s seed] [-o filename]
+    [-m full|streamed] [-i]
+
+A streamed world only has its spawn point found now, and the rest is generated
+as it's played. The world is saved to filename (default "world.world")
+relative to the current directory. With -i, pictures of the foreground, the
+biomes and the overview are saved next to it, as filename.ppm,
+filename_biomes.ppm and filename_overview0.ppm. This needs to be run from the
+folder with the game's content in it, same as the game. */
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <mutex>
+#include <sys/resource.h> // For peak memory use
+#include "../src/world/Mapgen.hh"
+
+using namespace std;
+
+/* Print how to use this, and return the exit code to use. */
+static int usage(const char *name) {
+    cerr << "Usage: " << name << " [-t earth|test] [-w width -h height]"
+        << " [-s seed] [-o filename] [-m full|streamed] [-i]" << endl;
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    WorldType type = WorldType::EARTH;
+    string filename = "world.world";
+    int width = 0;
+    int height = 0;
+    bool streamed = false;
+    bool images = false;
+    bool hasSeed = false;
+    int seed = 0;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        /* The only option that doesn't take a value. */
+        if (arg == "-i") {
+            images = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return usage(argv[0]);
+        }
+        string value = argv[++i];
+        if (arg == "-t") {
+            if (value == "earth") {
+                type = WorldType::EARTH;
+            }
+            else if (value == "test") {
+                type = WorldType::TEST;
+            }
+            else {
+                cerr << "Unknown world type " << value << endl;
+                return usage(argv[0]);
+            }
+        }
+        else if (arg == "-w") {
+            width = atoi(value.c_str());
+        }
+        else if (arg == "-h") {
+            height = atoi(value.c_str());
+        }
+        else if (arg == "-s") {
+            hasSeed = true;
+            seed = atoi(value.c_str());
+        }
+        else if (arg == "-o") {
+            filename = value;
+        }
+        else if (arg == "-m") {
+            if (value != "full" && value != "streamed") {
+                cerr << "Unknown mode " << value << endl;
+                return usage(argv[0]);
+            }
+            streamed = value == "streamed";
+        }
+        else {
+            return usage(argv[0]);
+        }
+    }
+
+    /* Width and height only make sense together. */
+    if ((width > 0) != (height > 0) || width < 0 || height < 0) {
+        cerr << "Width and height must both be given and positive." << endl;
+        return usage(argv[0]);
+    }
+
+    /* Nothing is waiting on the status, but Mapgen still reports it. */
+    CreateState state = CreateState::NOT_STARTED;
+    int progress = 0;
+    mutex m;
+
+    Mapgen *mapgen = new Mapgen();
+    if (hasSeed) {
+        mapgen -> setSeed(seed);
+    }
+    if (width > 0) {
+        mapgen -> setRequestedSize(width, height);
+    }
+    mapgen -> setStreamed(streamed);
+    mapgen -> generate(filename, type, &state, &progress, &m);
+    if (images) {
+        mapgen -> saveImages(filename);
+    }
+
+    /* Report the time spent on each step that took any time. */
+    double total = 0.0;
+    cout << "stage\tseconds\n";
+    for (int i = 0; i <= (int)CreateState::DONE; i++) {
+        double seconds = mapgen -> getSeconds((CreateState)i);
+        total += seconds;
+        if (seconds > 0.0) {
+            cout << Mapgen::getStateName((CreateState)i) << "\t" << seconds
+                << "\n";
+        }
+    }
+    cout << "total\t" << total << "\n";
+    delete mapgen;
+
+    /* On Linux, ru_maxrss is in kilobytes. */
+    struct rusage resources;
+    getrusage(RUSAGE_SELF, &resources);
+    cout << "peak_memory_kb\t" << resources.ru_maxrss << endl;
+
+    return 0;
+}